@@ -94,6 +94,7 @@
 #define __debugfn         __noinline __annotate( divine.debugfn )
 #define __link_always     __annotate( divine.link.always )
 #define __trapfn          __noinline __annotate( divine.trapfn )
+#define __native          __annotate( divine.native )
 #define __skipcfl         __noinline __annotate( lart.interrupt.skipcfl )
 #define __local_skipcfl   __noinline __annotate( lart.interrupt.local.skipcfl )
 #define __invisible       __skipcfl __annotate( lart.interrupt.skipmem )
@@ -11,6 +11,7 @@
 
 __attribute__((__annotate__("lart.interrupt.skipcfl")))
 __attribute__((__annotate__("divine.link.always")))
+__attribute__((__annotate__("divine.native")))
 void * memset( void * s, int c, size_t n )
 {
     unsigned char * p = (unsigned char *) s;
@@ -95,6 +95,7 @@ struct Scheduler : public Next
         s.proc1->pid = 1;
 
         auto mainTask = newTaskMem( s.pool->get(), s.pool->get(), __dios_start, 0, s.proc1 );
+        __vm_trace( _VM_T_Symmetric, tasks.begin() ); /* for symmetry reduction */
         auto argv = construct_main_arg( "arg.", s.env, true );
         auto envp = construct_main_arg( "env.", s.env );
         setupMainTask( mainTask, argv.first, argv.second, envp.second );
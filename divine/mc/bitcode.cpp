@@ -29,14 +29,23 @@
 DIVINE_RELAX_WARNINGS
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/DiagnosticPrinter.h>
 #include <llvm/Object/IRObjectFile.h>
 DIVINE_UNRELAX_WARNINGS
 
 #include <brick-llvm>
+#include <brick-fs>
+#include <brick-hash>
 
 #include <utility>
+#include <iomanip>
+#include <sstream>
+#include <cstdio>
+#include <unistd.h>
 
 namespace divine::mc
 {
@@ -253,6 +262,123 @@ void BitCode::init()
     do_constants();
 }
 
+/* The key covers everything do_dios() and do_lart() depend on: the input
+ * module (the compiler options are already applied to it), the options they
+ * use and the version, since the runtime which is linked in and the LART
+ * passes come with the DIVINE binary. */
+void BitCode::program_cache( std::string dir, std::string version )
+{
+    std::string data;
+    llvm::raw_string_ostream str( data );
+    llvm::WriteBitcodeToFile( *_module, str );
+
+    auto field = [&]( const std::string &s ) { str << s.size() << ":" << s; };
+    auto flag = [&]( bool b ) { str << ( b ? "1" : "0" ); };
+
+    field( version );
+    field( _opts.dios_config );
+    field( _opts.lamp_config );
+    field( _opts.relaxed );
+    field( to_string( _opts.autotrace ) );
+    field( to_string( _opts.leakcheck ) );
+    /* the lengths keep the items of one list from being taken for another */
+    field( std::to_string( _opts.lart_passes.size() ) );
+    for ( auto p : _opts.lart_passes )
+        field( p );
+    field( std::to_string( _opts.bc_env.size() ) );
+    for ( auto &[ name, value ] : _opts.bc_env )
+        field( name ), field( std::string( value.begin(), value.end() ) );
+    for ( bool b : { bool( _opts.static_reduction ), bool( _opts.symbolic ),
+                     bool( _opts.sequential ), bool( _opts.synchronous ),
+                     bool( _opts.svcomp ), bool( _opts.mcsema ) } )
+        flag( b );
+    str.flush();
+
+    auto bytes = reinterpret_cast< const uint8_t * >( data.data() );
+    std::stringstream key;
+    key << std::hex << std::setfill( '0' );
+    for ( brq::hash64_t seed : { 0, 1 } )
+        key << std::setw( 16 ) << brq::hash( bytes, data.size(), seed );
+
+    _cache_dir = dir;
+    _cache_key = key.str();
+}
+
+bool BitCode::load_cached()
+{
+    if ( _cache_key.empty() )
+        return false;
+
+    auto load = [&]( std::string suffix ) -> std::unique_ptr< llvm::Module >
+    {
+        auto buf = llvm::MemoryBuffer::getFile( brq::join_path( _cache_dir, _cache_key + suffix ) );
+        if ( !buf )
+            return nullptr;
+        auto parsed = llvm::parseBitcodeFile( buf.get()->getMemBufferRef(), _module->getContext() );
+        if ( !parsed )
+        {
+            llvm::consumeError( parsed.takeError() );
+            return nullptr;
+        }
+        return std::move( parsed.get() );
+    };
+
+    auto pure = load( ".pure.bc" ), transformed = load( ".bc" );
+    if ( !pure || !transformed )
+        return false;
+
+    _pure_module = std::move( pure );
+    _module = std::move( transformed );
+    return true;
+}
+
+/* Each file is written under a temporary name first, so that concurrent runs
+ * with the same key never see a partial file. The transformed module goes
+ * last: the entry is only complete once it exists. The cache is only an
+ * optimisation, hence a failure to write it is not fatal. */
+void BitCode::save_cached()
+{
+    if ( _cache_key.empty() )
+        return;
+
+    ASSERT( _pure_module );
+
+    auto save = [&]( llvm::Module &m, std::string suffix )
+    {
+        auto path = brq::join_path( _cache_dir, _cache_key + suffix );
+        auto tmp = path + ".part." + std::to_string( ::getpid() );
+        std::error_code err;
+        llvm::raw_fd_ostream out( tmp, err, llvm::sys::fs::F_None );
+        if ( err )
+            brq::raise() << "creating " << tmp << ": " << err.message();
+        llvm::WriteBitcodeToFile( m, out );
+        out.close();
+        if ( out.has_error() )
+        {
+            auto msg = out.error().message();
+            out.clear_error(); /* or the destructor aborts */
+            std::remove( tmp.c_str() );
+            brq::raise() << "writing " << tmp << ": " << msg;
+        }
+        if ( std::rename( tmp.c_str(), path.c_str() ) )
+        {
+            std::remove( tmp.c_str() );
+            brq::raise< brq::system_error >() << "renaming " << tmp << " to " << path;
+        }
+    };
+
+    try
+    {
+        brq::create_dir( _cache_dir );
+        save( *_pure_module, ".pure.bc" );
+        save( *_module, ".bc" );
+    }
+    catch ( std::exception &e )
+    {
+        std::cerr << "W: could not save the program cache: " << e.what() << std::endl;
+    }
+}
+
 BitCode::~BitCode() { }
 
 std::shared_ptr< BitCode > BitCode::with_options( const BCOptions &opts, rt::DiosCC &cc_driver )
@@ -32,6 +32,7 @@ DIVINE_UNRELAX_WARNINGS
 
 #include <divine/dbg/info.hpp>
 #include <divine/rt/dios-cc.hpp>
+#include <divine/mc/compact.hpp>
 
 namespace llvm { class Module; }
 namespace divine::vm { struct Program; }
@@ -93,10 +94,22 @@ struct BitCode
     std::unique_ptr< dbg::Info > _dbg;
 
     std::string _solver;
+    mc::storage _storage = mc::storage::exact;
+    size_t _storage_size = 0;
+    bool _tree_compression = false;
+    bool _por = false;
+    bool _symmetry = false;
+    bool _subsumption = false;
     BCOptions _opts;
 
     bool is_symbolic() const { return _opts.symbolic; }
     std::string solver() const { ASSERT( is_symbolic() ); return _solver; }
+    mc::storage storage() const { return _storage; }
+    size_t storage_size() const { return _storage_size; }
+    bool tree_compression() const { return _tree_compression; }
+    bool por() const { return _por; }
+    bool symmetry() const { return _symmetry; }
+    bool subsumption() const { return _subsumption; }
 
     vm::Program &program() { ASSERT( _program.get() ); return *_program.get(); }
     dbg::Info &debug() { ASSERT( _dbg.get() ); return *_dbg.get(); }
@@ -107,12 +120,26 @@ struct BitCode
 
     void set_options( const BCOptions& opts ) { _opts = opts; }
     void solver( std::string s ) { _solver = s; }
+    void storage( mc::storage s, size_t bytes ) { _storage = s; _storage_size = bytes; }
+    void tree_compression( bool t ) { _tree_compression = t; }
+    void por( bool p ) { _por = p; }
+    void symmetry( bool s ) { _symmetry = s; }
+    void subsumption( bool s ) { _subsumption = s; }
 
     void do_lart();
     void do_dios();
     void do_rr();
     void do_constants();
 
+    /* The program cache (see `--program-cache`) keeps the result of
+     * do_dios() and do_lart() in 'dir', addressed by a hash of the input
+     * module, the options and 'version' (which identifies DIVINE and its
+     * runtime). If load_cached() succeeds, the two steps must be skipped;
+     * otherwise save_cached() stores their result for the next run. */
+    void program_cache( std::string dir, std::string version );
+    bool load_cached();
+    void save_cached();
+
     void init();
 
     // TODO: Disables move synthesis, probably should be removed
@@ -121,6 +148,8 @@ struct BitCode
     static std::shared_ptr< BitCode > with_options( const BCOptions &opts, rt::DiosCC &cc_driver );
 
 private:
+    std::string _cache_dir, _cache_key;
+
     void lazy_link_dios();
     void _save_original_module();
 };
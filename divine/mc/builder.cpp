@@ -24,4 +24,5 @@
 namespace divine
 {
    template struct vm::Eval< mc::Context >;
+   template struct vm::Eval< mc::SearchContext >;
 }
@@ -21,6 +21,7 @@
 #include <divine/mc/types.hpp>
 #include <divine/mc/bitcode.hpp>
 #include <divine/mc/hasher.hpp>
+#include <divine/mc/compact.hpp>
 #include <divine/mc/context.hpp>
 #include <divine/smt/solver.hpp>
 #include <divine/vm/value.hpp>
@@ -42,6 +43,23 @@ struct State
     Snapshot snap;
     bool operator==( const State &o ) const { return snap.intptr() == o.snap.intptr(); }
     bool operator!=( const State &o ) const { return !(*this == o); }
+    brq::hash64_t hash() const { return brq::hash( uint64_t( snap.intptr() ) ); }
+};
+
+/* Shared by the search and the debug flavour of the builder, so that the
+ * labels of a counterexample can be compared against the replayed ones. */
+struct Label : brick::types::Ord
+{
+    std::vector< std::string > trace;
+    std::vector< vm::Choice > stack;
+    std::vector< vm::Interrupt > interrupts;
+    bool accepting:1;
+    bool error:1;
+    auto as_tuple() const
+    {
+        /* skip the text trace for comparison purposes */
+        return std::make_tuple( stack, interrupts, accepting, error );
+    }
 };
 
 using BC = std::shared_ptr< BitCode >;
@@ -51,34 +69,37 @@ using BC = std::shared_ptr< BitCode >;
 namespace divine::mc
 {
 
-template< typename Solver >
+/* The search uses a context without debug mode (see ctx::nodebug). Debug
+ * output only shows up in the edge labels of a Builder with the full
+ * mc::Context, which is what Debug is for. */
+template< typename Solver, typename Context_ = mc::SearchContext >
 struct Builder
 {
     using PointerV = vm::value::Pointer;
-    using Context = mc::Context;
+    using Context = Context_;
     using Eval = vm::Eval< Context >;
     using Hasher = mc::Hasher< Solver >;
+    using Debug = Builder< Solver, mc::Context >;
 
     using BC = builder::BC;
     using Env = std::vector< std::string >;
     using State = builder::State;
+    using Label = builder::Label;
     using Snapshot = vm::CowHeap::Snapshot;
 
-    struct Label : brick::types::Ord
+    using HT = brq::concurrent_hash_set< Snapshot >;
+
+    /* With compact storage, snapshots are released as soon as they are no
+     * longer needed: a state is kept alive while it waits to be expanded, or
+     * while any of its descendants is alive (so that counterexamples can be
+     * reconstructed by following the parent links). */
+    struct Node
     {
-        std::vector< std::string > trace;
-        std::vector< vm::Choice > stack;
-        std::vector< vm::Interrupt > interrupts;
-        bool accepting:1;
-        bool error:1;
-        auto as_tuple() const
-        {
-            /* skip the text trace for comparison purposes */
-            return std::make_tuple( stack, interrupts, accepting, error );
-        }
+        std::atomic< Snapshot > parent;
+        std::atomic< int > refs;
     };
 
-    using HT = brq::concurrent_hash_set< Snapshot >;
+    using Tree = brick::mem::SlavePool< vm::CowHeap::Pool >;
 
     auto &program() { return _d.bc->program(); }
     auto &debug() { return _d.bc->debug(); }
@@ -93,6 +114,11 @@ struct Builder
         builder::State initial;
         Solver solver;
         vm::CowHeap::Pool pool;
+        mc::storage storage = mc::storage::exact;
+        size_t storage_size = 0;
+        CompactStore compact;
+        Tree tree;
+        bool por = false, symmetry = false, partitioned = false;
 
         int64_t local_instructions = 0, local_states = 0;
         std::shared_ptr< std::atomic< int64_t > > total_instructions, total_states;
@@ -104,11 +130,24 @@ struct Builder
 
         template< typename... Args >
         Data( BC bc, const Context &ctx, HT states, Args... solver_opts )
-            : bc( bc ), ctx( ctx ), states( states ), solver( solver_opts... ),
+            : bc( bc ), ctx( ctx ), states( states ), solver( solver_opts... ), tree( pool ),
               total_instructions( new std::atomic< int64_t >( 0 ) ),
               total_states( new std::atomic< int64_t >( 0 ) )
         {}
 
+        /* Take over the state space of a builder with a different context;
+         * only the registers and the heap of the context are copied. */
+        template< typename OData >
+        explicit Data( const OData &o )
+            : bc( o.bc ), ctx( o.bc->program() ), states( o.states ), initial( o.initial ),
+              solver( o.solver ), pool( o.pool ), storage( o.storage ),
+              storage_size( o.storage_size ), compact( o.compact ), tree( o.tree ),
+              por( o.por ), symmetry( o.symmetry ), partitioned( o.partitioned ),
+              total_instructions( o.total_instructions ), total_states( o.total_states )
+        {
+            ctx.load( o.ctx );
+        }
+
         void sync()
         {
             *total_instructions += local_instructions;
@@ -123,19 +162,99 @@ struct Builder
     Context &context() { return _d.ctx; }
     void enable_overwrite() { _hasher.overwrite = true; }
 
+    /* Symbolic states which are covered by a visited state are not explored
+     * again; see Hasher::covered(). */
+    void subsumption( bool enable ) { _hasher.subsume = enable; }
+
     auto &hasher() { return _hasher; }
 
+    void storage( mc::storage mode, size_t bytes = 0 )
+    {
+        _d.storage = mode;
+        _d.storage_size = bytes;
+        _d.compact = CompactStore( mode, bytes );
+    }
+
+    /* Must be called before start(); see mem::Cow::tree_compression. */
+    void tree_compression()
+    {
+        ASSERT( _d.storage == mc::storage::exact );
+        heap().tree_compression( pool() );
+        hasher()._h1 = heap();
+        hasher()._h2 = heap();
+    }
+
+    /* Enable partial order reduction; see por_thread() below. */
+    void por( bool enable ) { _d.por = enable; }
+
+    /* Enable symmetry reduction (see Hasher::canonicalise); must be called
+     * before start(). */
+    void symmetry( bool enable ) { _d.symmetry = enable; }
+
+    /* States are stored by the search, each partition of the state space in
+     * its own table (see ss::Distributed). */
+    void partitioned( bool enable ) { _d.partitioned = enable; }
+
+    bool external() const { return _d.storage == mc::storage::external; }
+    double omissions() const { return _d.compact.omissions(); }
+
     Builder( const Builder &e ) : _d( e._d ), _hasher( e._hasher, _d.pool, _d.solver )
     {}
 
+    /* A view of the state space of 'o' through a different context, e.g. a
+     * Debug builder to replay a counterexample found by the search. */
+    template< typename C >
+    explicit Builder( const Builder< Solver, C > &o )
+        : _d( o._d ), _hasher( o._hasher, _d.pool, _d.solver )
+    {}
+
     template< typename... Args >
     Builder( BC bc, Args && ... args ) : _d( bc, args... ), _hasher( _d.pool, _d.ctx.heap(), _d.solver )
     {}
 
-    std::pair< Snapshot, bool > store( Snapshot snap )
+    Node &node( Snapshot s ) { return *_d.tree.template machinePointer< Node >( s ); }
+
+    void release( Snapshot s )
+    {
+        heap().snap_put( pool(), s );
+        heap().snap_put(); /* s may be the current heap, which is not used again before a load */
+    }
+
+    void unref( Snapshot s )
+    {
+        while ( pool().valid( s ) && -- node( s ).refs == 0 )
+        {
+            Snapshot parent = node( s ).parent;
+            release( s );
+            s = parent;
+        }
+    }
+
+    std::pair< Snapshot, bool > store_compact( Snapshot snap, Snapshot parent )
+    {
+        if ( !_d.compact.insert( hasher().hash( snap ) ) )
+            return { snap, false }; /* edges() releases the duplicate after yielding it */
+
+        ++ _d.local_states;
+        context().flush_ptr2i();
+        _d.tree.materialise( snap, sizeof( Node ) );
+        node( snap ).parent = parent;
+        if ( pool().valid( parent ) )
+            node( snap ).refs = 1, ++ node( parent ).refs;
+        else
+            node( snap ).refs = 2; /* initial states are never released */
+        return { snap, true };
+    }
+
+    std::pair< Snapshot, bool > store( Snapshot snap, Snapshot parent = Snapshot() )
     {
         hash_timer _timer;
         _hasher.prepare( snap );
+        if ( _d.compact )
+            return store_compact( snap, parent );
+        if ( external() || _d.partitioned )
+            return context().flush_ptr2i(), std::make_pair( snap, true ); /* see ss::External */
+
         auto r = _d.states.insert( snap, hasher() );
         if ( r->load() != snap )
         {
@@ -151,6 +270,103 @@ struct Builder
         }
     }
 
+    /* Support for ss::External, which keeps states on disk. The serialised
+     * form of a state is its snapshot, i.e. a list of references into the
+     * (deduplicated) object table. Each stored copy of the snapshot owns a
+     * reference to each of its objects, except for the in-memory copies
+     * created by undump(), which borrow the references of the copy on disk
+     * and must be released using forget(). */
+
+    brq::hash64_t hash( State st ) { return hasher().hash( st.snap ); }
+    bool equal( State a, State b ) { return equal( a.snap, b.snap ); }
+    void release( State st ) { if ( pool().valid( st.snap ) ) release( st.snap ); }
+    void forget( State st ) { if ( pool().valid( st.snap ) ) pool().free( st.snap ); }
+
+    void dump( State st, std::vector< uint8_t > &out )
+    {
+        if ( !pool().valid( st.snap ) )
+            return;
+        auto data = pool().template machinePointer< uint8_t >( st.snap );
+        out.insert( out.end(), data, data + pool().size( st.snap ) );
+    }
+
+    State undump( const std::vector< uint8_t > &data )
+    {
+        State st;
+        if ( data.empty() )
+            return st;
+        st.snap = pool().allocate( data.size() );
+        std::copy( data.begin(), data.end(), pool().template machinePointer< uint8_t >( st.snap ) );
+        _hasher.prepare( st.snap );
+        return st;
+    }
+
+    template< typename F >
+    void stored( F f )
+    {
+        for ( size_t i = 0; i < _d.states.capacity(); ++i )
+            if ( _d.states.valid( i ) )
+                f( State{ _d.states.valueAt( i ) } );
+    }
+
+    /* Checkpoints (see Safety::checkpoint). The image holds the snapshot
+     * pool along with the snapshot hashes, the heap (including the objects
+     * of all stored states) and the list of stored states, from which the
+     * hash table is rebuilt by load().
+     * The program is not part of the image and must be loaded (and booted)
+     * as usual; the hash of the initial state serves as its fingerprint. */
+
+    brq::hash64_t fingerprint()
+    {
+        if ( !pool().valid( _d.initial.snap ) )
+            brq::raise() << "the program has no initial state";
+        return hasher().hash( _d.initial.snap );
+    }
+
+    template< typename Image >
+    void save( Image &img )
+    {
+        ASSERT( _d.storage == mc::storage::exact );
+        _d.sync();
+        img.put( _d.initial.snap );
+        img.put( _d.total_states->load() );
+        img.put( _d.total_instructions->load() );
+        heap().save( img );
+        hasher()._hashes.save( img );
+        pool().save( img );
+
+        std::vector< Snapshot > states;
+        stored( [&]( State st ) { states.push_back( st.snap ); } );
+        img.put( uint64_t( states.size() ) );
+        for ( auto s : states )
+            img.put( s );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        ASSERT( _d.storage == mc::storage::exact );
+        _d.initial.snap = img.template get< Snapshot >();
+        *_d.total_states = img.template get< int64_t >();
+        *_d.total_instructions = img.template get< int64_t >();
+        heap().load( img );
+        hasher()._hashes.load( img );
+        pool().load( img );
+        context().flush_ptr2i();
+        hasher().attach( heap() );
+
+        _d.states = HT();
+        for ( auto count = img.template get< uint64_t >(); count; --count )
+        {
+            auto snap = img.template get< Snapshot >();
+            auto h = hasher().stored_hash( snap ); /* saved along with the pool */
+            _hasher.prepare( snap );
+            if ( h )
+                hasher().remember( snap, h );
+            _d.states.insert( snap, h ? h : hasher().hash( snap ), hasher() );
+        }
+    }
+
     void start()
     {
         Eval eval( context() );
@@ -159,7 +375,10 @@ struct Builder
         eval.run();
         hasher()._root = context().state_ptr();
         hasher()._path = context().constraint_ptr();
+        if ( _d.symmetry )
+            hasher()._symmetric = context()._symmetric;
 
+        hasher().canonicalise( context().heap() );
         auto s = context().snapshot( pool() );
         if ( vm::setup::postboot_check( context() ) )
             std::tie( _d.initial.snap, std::ignore ) = store( s );
@@ -199,14 +418,113 @@ struct Builder
 
     bool equal( Snapshot a, Snapshot b ) { return hasher().equal_symbolic( a, b ); }
 
+    Snapshot snapshot()
+    {
+        if ( hasher().canonicalise( context().heap() ) )
+            context().flush_ptr2i();
+        return context().heap().snapshot( pool() );
+    }
+
     bool feasible()
     {
         if ( context().flags_any( _VM_CF_Cancel ) )
             return false;
+
+        /* the list only ever grows during a run, hence an incremental
+         * solver only needs to check the new assumptions */
+        smt::solver::Assumes as;
         for ( auto a : context()._assume )
-            if ( context().heap().valid( a ) && !_d.solver.feasible( context().heap(), a ) )
-                return false;
-        return true;
+            if ( context().heap().valid( a ) )
+                as.push_back( a );
+        return as.empty() || _d.solver.feasible( context().heap(), as );
+    }
+
+    /* One run of the scheduler from a given state, i.e. one step of one
+     * thread (along with the choices it made). */
+    struct Check
+    {
+        std::deque< vm::Choice > lock;
+        Label lbl;
+        Snapshot snap;
+        bool feasible:1;
+        vm::GenericPointer tid;
+        Check() : feasible( true ) {}
+    };
+
+    /* Partial order reduction. We look for a thread whose every step (from
+     * the state 'from') only touches memory that is private to the thread,
+     * i.e. objects that cannot be reached from the state root without
+     * passing through the task of the thread itself, and which does not
+     * change anything else. No step of any other thread can read or write
+     * that memory, neither now nor later (unless the thread itself makes
+     * it reachable, which would be a non-private step), hence the steps of
+     * such a thread are independent of everything the other threads do and
+     * it is enough to explore only those steps from 'from' (this is a
+     * stubborn set consisting of a single thread). Steps which hit an error
+     * are visible and are never reduced.
+     *
+     * The accesses are those recorded by test_crit for the thread (i.e. for
+     * all of its steps), which means that kernel-mode accesses are not
+     * included; the comparison of the rest of the heap (see
+     * Hasher::equal_except) makes up for that, since any system call which
+     * affects other threads changes memory outside of the thread.
+     *
+     * Returns the task pointer of the thread, or a null pointer if there is
+     * none (or if there is just one thread, so that nothing can be saved). */
+    vm::GenericPointer por_thread( builder::State from, std::vector< Check > &to_check )
+    {
+        std::set< vm::GenericPointer > tids, bad;
+
+        for ( auto &tc : to_check )
+        {
+            tids.insert( tc.tid );
+            if ( tc.tid.null() || ( tc.feasible && tc.lbl.error ) )
+                bad.insert( tc.tid );
+        }
+
+        if ( tids.size() < 2 )
+            return vm::GenericPointer();
+
+        mem::ObjSet shared, unused;
+
+        for ( auto tid : tids )
+        {
+            if ( bad.count( tid ) )
+                continue;
+
+            shared.clear();
+            shared.insert( tid.object() );
+            hasher()._h1.restore( pool(), from.snap );
+            mem::reachable( hasher()._h1, hasher()._root, unused, shared );
+            shared.erase( tid.object() );
+
+            auto &crit = context()._critical[ tid ];
+            auto is_private = [&]( auto &set )
+            {
+                for ( auto r : set )
+                    if ( shared.count( r.first.object() ) )
+                        return false;
+                return true;
+            };
+
+            if ( !is_private( crit.loads ) || !is_private( crit.stores ) )
+                continue;
+
+            /* a thread with no feasible step is not a stubborn set, even
+             * though none of its (non-existent) steps is visible */
+            bool local = true, enabled = false;
+            for ( auto &tc : to_check )
+                if ( tc.tid == tid && tc.feasible )
+                {
+                    enabled = true;
+                    local = local && hasher().equal_except( from.snap, tc.snap, tid );
+                }
+
+            if ( enabled && local )
+                return tid;
+        }
+
+        return vm::GenericPointer();
     }
 
     template< typename Y >
@@ -220,16 +538,6 @@ struct Builder
         ASSERT( context()._assume.empty() );
         context()._critical.clear();
 
-        struct Check
-        {
-            std::deque< vm::Choice > lock;
-            Label lbl;
-            Snapshot snap;
-            bool feasible:1;
-            vm::GenericPointer tid;
-            Check() : feasible( true ) {}
-        };
-
         std::vector< Check > to_check;
 
         auto do_yield = [&]( Snapshot snap, Label lbl )
@@ -237,8 +545,11 @@ struct Builder
             builder::State st;
             bool isnew;
 
-            std::tie( st.snap, isnew ) = store( snap );
+            std::tie( st.snap, isnew ) = store( snap, from.snap );
             yield( st, lbl, isnew );
+            if ( _d.compact && !isnew )
+                release( st.snap );
+            return isnew;
         };
 
         auto do_eval = [&]( Check &tc )
@@ -271,7 +582,7 @@ struct Builder
 
             if ( tc.feasible )
             {
-                tc.snap = context().heap().snapshot( pool() );
+                tc.snap = snapshot();
                 tc.lbl = label();
             }
             tc.tid = context()._tid;
@@ -279,9 +590,11 @@ struct Builder
 
         context().track_memory( false );
 
-        for ( auto &tc : to_check )
+        /* returns false if any of the successors was already visited */
+        auto expand = [&]( Check &tc )
         {
             typename Context::MemMap l, s;
+            bool isnew = true;
 
             for ( auto &c : context()._critical )
             {
@@ -304,7 +617,7 @@ struct Builder
             if ( s.empty() && l.empty() )
             {
                 if ( tc.feasible )
-                    do_yield( tc.snap, tc.lbl );
+                    isnew = do_yield( tc.snap, tc.lbl );
             }
             else
             {
@@ -326,7 +639,7 @@ struct Builder
                 if ( tc.feasible )
                 {
                     auto lbl = label();
-                    do_yield( context().heap().snapshot( pool() ), lbl );
+                    isnew = do_yield( snapshot(), lbl );
 
                     int i = 0;
                     for ( auto t : lbl.stack )
@@ -337,7 +650,40 @@ struct Builder
                 context()._lock.clear();
                 context().finished();
             }
+
+            return isnew;
+        };
+
+        vm::GenericPointer reduced;
+        if ( _d.por )
+            reduced = por_thread( from, to_check );
+
+        if ( reduced.null() )
+            for ( auto &tc : to_check )
+                expand( tc );
+        else
+        {
+            /* The cycle proviso: if any of the reduced successors has been
+             * seen before, the state is fully expanded. Every cycle in the
+             * reduced state space is closed by an edge which leads to an
+             * old state, hence no cycle can postpone the other threads
+             * forever. */
+            bool proviso = true;
+            for ( auto &tc : to_check )
+                if ( tc.tid == reduced )
+                    proviso = expand( tc ) && proviso;
+
+            for ( auto &tc : to_check )
+                if ( tc.tid == reduced )
+                    continue;
+                else if ( !proviso )
+                    expand( tc );
+                else if ( tc.feasible )
+                    heap().snap_put( pool(), tc.snap );
         }
+
+        if ( _d.compact )
+            unref( from.snap );
     }
 
     template< typename Y >
@@ -348,6 +694,27 @@ struct Builder
     }
 };
 
+/* A builder which starts the search from an arbitrary set of (already
+ * stored) states, used to run the individual OWCTY phases on top of
+ * ss::Search and to resume a search from a checkpoint. */
+template< typename Builder >
+struct Seeded : Builder
+{
+    using State = typename Builder::State;
+    std::shared_ptr< std::vector< State > > _seeds;
+
+    Seeded( const Builder &b, std::shared_ptr< std::vector< State > > seeds )
+        : Builder( b ), _seeds( seeds )
+    {}
+
+    template< typename Y >
+    void initials( Y yield )
+    {
+        for ( auto s : *_seeds )
+            yield( s );
+    }
+};
+
 using ExplicitBuilder = Builder< smt::NoSolver >;
 using SMTLibBuilder = Builder< smt::SMTLibSolver >;
 
@@ -359,4 +726,8 @@ using Z3Builder = Builder< smt::Z3Solver >;
 using STPBuilder = Builder< smt::STPSolver >;
 #endif
 
+#if OPT_STP && OPT_Z3
+using PortfolioBuilder = Builder< smt::PortfolioSolver >;
+#endif
+
 }
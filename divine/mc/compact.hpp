@@ -0,0 +1,182 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <brick-mmap>
+#include <brick-string>
+#include <brick-assert>
+
+#include <atomic>
+#include <memory>
+#include <cmath>
+
+namespace divine::mc
+{
+    /* How the set of visited states is represented. The 'exact' storage keeps
+     * every snapshot in a hash table; 'compact' (hash compaction) only keeps
+     * the 64-bit hash of each state in an open-addressed table and 'bitstate'
+     * (supertrace) only sets a few bits per state in a large bit array. Both
+     * of the latter may wrongly consider a new state to be already visited,
+     * which means that parts of the state space may be silently omitted.
+     * Finally, 'external' storage keeps snapshots on disk and uses delayed
+     * duplicate detection (see ss::External). */
+
+    enum class storage { exact, compact, bitstate, external };
+
+    static brq::parse_result from_string( std::string_view s, storage &st )
+    {
+        if      ( s == "exact" ) st = storage::exact;
+        else if ( s == "compact" ) st = storage::compact;
+        else if ( s == "bitstate" ) st = storage::bitstate;
+        else if ( s == "external" ) st = storage::external;
+        else return brq::no_parse( "storage must be exact, compact, bitstate or external" );
+        return {};
+    }
+
+    static inline std::string to_string( storage st )
+    {
+        switch ( st )
+        {
+            case storage::exact: return "exact";
+            case storage::compact: return "compact";
+            case storage::bitstate: return "bitstate";
+            case storage::external: return "external";
+        }
+        UNREACHABLE( "invalid storage mode" );
+    }
+
+    struct CompactStore
+    {
+        using word = std::atomic< uint64_t >;
+
+        static constexpr int bitstate_k = 3;    /* bits set per state */
+        static constexpr int probe_limit = 64;  /* give up on a crowded compact table */
+        static constexpr size_t default_size = 512 * 1024 * 1024;
+
+        struct Table
+        {
+            storage mode;
+            size_t bytes, mask;
+            word *data;
+            std::atomic< int64_t > count, dropped;
+
+            Table( storage m, size_t b )
+                : mode( m ), bytes( 8 ), count( 0 ), dropped( 0 )
+            {
+                ASSERT( m == storage::compact || m == storage::bitstate );
+                while ( bytes * 2 <= b )
+                    bytes *= 2;
+                data = static_cast< word * >( brick::mmap::MMap::alloc( bytes ) );
+                /* compact: one fingerprint per word; bitstate: one state per bit */
+                mask = ( mode == storage::compact ? bytes / 8 : bytes * 8 ) - 1;
+            }
+
+            ~Table() { brick::mmap::MMap::drop( data, bytes ); }
+        };
+
+        std::shared_ptr< Table > _t;
+
+        CompactStore() = default;
+        CompactStore( storage m, size_t bytes )
+            : _t( m != storage::compact && m != storage::bitstate ? nullptr
+                  : new Table( m, bytes ? bytes : default_size ) )
+        {}
+
+        explicit operator bool() const { return bool( _t ); }
+        storage mode() const { return _t ? _t->mode : storage::exact; }
+
+        /* returns true if the state has not been seen before */
+        bool insert( uint64_t hash )
+        {
+            ASSERT( _t );
+            if ( _t->mode == storage::compact ? insert_fingerprint( hash ) : insert_bits( hash ) )
+                return ++ _t->count, true;
+            return false;
+        }
+
+        bool insert_fingerprint( uint64_t fp )
+        {
+            fp = fp ? fp : 1; /* zero marks an empty slot */
+
+            for ( size_t i = 0, idx = fp & _t->mask; i < probe_limit; ++i, idx = ( idx + 1 ) & _t->mask )
+            {
+                auto &slot = _t->data[ idx ];
+                uint64_t cur = slot.load( std::memory_order_relaxed );
+                if ( !cur && slot.compare_exchange_strong( cur, fp ) )
+                    return true;
+                if ( cur == fp )
+                    return false;
+            }
+
+            ++ _t->dropped;
+            return false;
+        }
+
+        bool insert_bits( uint64_t hash )
+        {
+            /* double hashing: derive bitstate_k positions from one 64-bit hash */
+            uint64_t h1 = hash, h2 = ( hash >> 32 ) | 1;
+            bool fresh = false;
+
+            for ( int i = 0; i < bitstate_k; ++i )
+            {
+                uint64_t bit = ( h1 + i * h2 ) & _t->mask, m = uint64_t( 1 ) << ( bit % 64 );
+                auto &w = _t->data[ bit / 64 ];
+                if ( w.load( std::memory_order_relaxed ) & m )
+                    continue;
+                if ( !( w.fetch_or( m ) & m ) )
+                    fresh = true;
+            }
+
+            return fresh;
+        }
+
+        int64_t stored() const { return _t ? _t->count.load() : 0; }
+
+        /* The expected number of states that were wrongly considered visited.
+         * For hash compaction, this is the expected number of 64-bit
+         * collisions among the stored states, plus the number of insertions
+         * which did not fit into the table at all (a state which is reached
+         * repeatedly is counted each time, hence this is an upper bound). For bitstate hashing, a state is lost
+         * when all of its bits have been set by other states; with i states
+         * stored, this happens with probability (1 - exp(-k * i / m))^k. */
+        double omissions() const
+        {
+            if ( !_t )
+                return 0;
+
+            double n = _t->count.load();
+
+            if ( _t->mode == storage::compact )
+                return n * ( n - 1 ) / std::ldexp( 1.0, 65 ) + _t->dropped.load();
+
+            double m = double( _t->mask ) + 1, k = bitstate_k, sum = 0;
+            const int steps = 1000;
+            auto f = [&]( double i ) { return std::pow( 1 - std::exp( -k * i / m ), k ); };
+
+            for ( int s = 0; s < steps; ++s ) /* midpoint rule for the sum over i */
+                sum += f( n * ( s + 0.5 ) / steps );
+            return sum * n / steps;
+        }
+
+        /* the probability that at least one state was omitted */
+        double omission_probability() const
+        {
+            return 1 - std::exp( -omissions() );
+        }
+    };
+}
@@ -23,10 +23,10 @@ namespace divine::mc
 {
     using Snapshot = vm::CowHeap::Snapshot;
 
-    struct Context : vm::Context< vm::Program, vm::CowHeap >
+    template< typename Super >
+    struct Context_ : Super
     {
-        using Super = vm::Context< vm::Program, vm::CowHeap >;
-        using MemMap = Super::MemMap;
+        using MemMap = typename Super::MemMap;
         struct Critical { MemMap loads, stores; };
 
         std::vector< std::string > _trace;
@@ -35,11 +35,12 @@ namespace divine::mc
         std::deque< vm::Choice > _lock;
         std::vector< vm::HeapPointer > _assume;
         vm::GenericPointer _tid;
+        vm::HeapPointer _symmetric;
         MemMap _mem_loads, _mem_stores, _crit_loads, _crit_stores;
         std::unordered_map< vm::GenericPointer, Critical > _critical;
         int _level;
 
-        Context( vm::Program &p ) : _level( 0 ) { this->program( p ); }
+        Context_( vm::Program &p ) : _level( 0 ) { this->program( p ); }
 
         template< typename I >
         int choose( int count, I, I )
@@ -85,8 +86,8 @@ namespace divine::mc
         void trace( vm::TraceAssume ta )
         {
             _assume.push_back( ta.ptr );
-            if ( debug_allowed() )
-                trace( "ASSUME " + smt::extract::to_string( heap(), ta.ptr ) );
+            if ( this->debug_allowed() )
+                trace( "ASSUME " + smt::extract::to_string( this->heap(), ta.ptr ) );
         }
 
         bool test_crit( vm::CodePointer pc, vm::GenericPointer ptr, int size, int type )
@@ -100,16 +101,16 @@ namespace divine::mc
             if ( type == _VM_MAT_Load || type == _VM_MAT_Both )
             {
                 if ( _crit_loads.intersect( start, end ) )
-                    return track_test( vm::Interrupt::Mem, pc );
-                else if ( _track_mem )
+                    return this->track_test( vm::Interrupt::Mem, pc );
+                else if ( this->_track_mem )
                     _mem_loads.insert( start, end );
             }
 
             if ( type == _VM_MAT_Store || type == _VM_MAT_Both )
             {
                 if ( _crit_stores.intersect( start, end ) )
-                    return track_test( vm::Interrupt::Mem, pc );
-                else if ( _track_mem )
+                    return this->track_test( vm::Interrupt::Mem, pc );
+                else if ( this->_track_mem )
                     _mem_stores.insert( start, end );
             }
 
@@ -133,9 +134,11 @@ namespace divine::mc
             swap_critical();
         }
 
+        void trace( vm::TraceSymmetric ts ) { _symmetric = ts.ptr; }
+
         void trace( vm::TraceInfo ti )
         {
-            _info += heap().read_string( ti.text ) + "\n";
+            _info += this->heap().read_string( ti.text ) + "\n";
         }
 
         bool finished()
@@ -153,4 +156,10 @@ namespace divine::mc
         }
     };
 
+    /* The search runs in a context without debug mode; the debug-enabled one
+     * is only needed to replay a counterexample (or to draw the state space)
+     * with the output of the debug functions in the edge labels. */
+    using Context = Context_< vm::Context< vm::Program, vm::CowHeap > >;
+    using SearchContext = Context_< vm::SearchContext< vm::Program, vm::CowHeap > >;
+
 }
@@ -106,9 +106,9 @@ std::string draw_impl( Builder &bld, std::shared_ptr< BitCode > bc, int distance
 } // anonymous namespace
 
 #if OPT_STP
-using DrawBuilder = STPBuilder;
+using DrawBuilder = STPBuilder::Debug;
 #else
-using DrawBuilder = ExplicitBuilder;
+using DrawBuilder = ExplicitBuilder::Debug;
 #endif
 
 template< typename Builder = DrawBuilder, typename Ctx = Context >
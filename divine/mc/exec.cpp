@@ -234,10 +234,14 @@ namespace divine::mc
         exec_t< solver_t > c;
         c.bc( _bc );
         c.context().enable_debug();
-        weave( c, b ).start();
+        auto w = weave( c, b );
+        w.start(); /* the tactics follow one path at a time, a single thread will do */
 
+        c.update_instructions();
+        _stats = { w.template delivered< task::store_state >(), *c._total_instructions };
         _ps[ "snapshot memory" ] = c._state_pool.stats();
         _ps[ "fragment memory" ] = c.context().heap().mem_stats();
+        _ps[ "message queue" ] = w.mq_stats();
     }
 
     // This is ugly and we don't want it here...
@@ -79,6 +79,7 @@ struct Exec
 
     BC _bc;
     PoolStats _ps;
+    std::pair< int64_t, int64_t > _stats = { 0, 0 }; /* states, instructions */
 
     Exec( BC bc ) : _bc( bc ) {}
 
@@ -89,6 +90,7 @@ struct Exec
     void trace();
 
     PoolStats poolstats() { return _ps; }
+    std::pair< int64_t, int64_t > stats() { return _stats; }
 };
 
 }
@@ -46,17 +46,22 @@ namespace divine::mc::impl
     {
         using Snapshot = vm::CowHeap::Snapshot;
         using Pool = vm::CowHeap::Pool;
+        using HPool = brick::mem::SlavePool< Pool >;
 
         Pool &_pool;
         Solver &_solver;
         mutable vm::CowHeap _h1, _h2;
-        vm::HeapPointer _root, _path;
-        bool overwrite = false;
+        mutable HPool _hashes;
+        mutable mem::Visited _v1, _v2; /* scratch space for compare and hash */
+        vm::HeapPointer _root, _path, _symmetric;
+        bool overwrite = false, subsume = false;
+        bool cache = true; /* remember the hashes, see prepare() */
 
         void attach( const vm::CowHeap &heap )
         {
             _h1 = heap;
             _h2 = heap;
+            _hashes.attach( _pool );
         }
 
         Hasher( Pool &pool, Solver &solver )
@@ -64,25 +69,42 @@ namespace divine::mc::impl
         {}
 
         Hasher( Pool &pool, const vm::CowHeap &heap, Solver &solver )
-            : _pool( pool ), _solver( solver ), _h1( heap ), _h2( heap )
+            : _pool( pool ), _solver( solver ), _h1( heap ), _h2( heap ), _hashes( pool )
         {}
 
         Hasher( const Hasher &o, Pool &p, Solver &s )
             : Hasher( p, o._h1, s )
         {
+            _hashes = o._hashes;
             _root = o._root;
             _path = o._path;
+            _symmetric = o._symmetric;
             overwrite = o.overwrite;
+            subsume = o.subsume;
+            cache = o.cache;
         }
 
-        void prepare( Snapshot ) {}
+        using HashSlot = std::atomic< brq::hash64_t >;
+
+        HashSlot &hash_slot( Snapshot s ) const
+        {
+            return *_hashes.template machinePointer< HashSlot >( s );
+        }
+
+        /* Called by the thread which created the snapshot, before it is
+         * published (i.e. inserted into a table or handed over to another
+         * thread), so that nobody else ever needs to materialise the slot. */
+        void prepare( Snapshot s )
+        {
+            if ( !cache )
+                return;
+            _hashes.materialise( s, sizeof( HashSlot ), false );
+            new ( &hash_slot( s ) ) HashSlot( 0 );
+        }
 
         bool equal_fastpath( Snapshot a, Snapshot b ) const
         {
-            bool rv = false;
-            if ( _pool.size( a ) == _pool.size( b ) )
-                rv = std::equal( _h1.snap_begin( _pool, a ), _h1.snap_end( _pool, a ),
-                                 _h1.snap_begin( _pool, b ) );
+            bool rv = _h1.snap_equal( _pool, a, b );
             if ( !rv )
                 _h1.restore( _pool, a ), _h2.restore( _pool, b );
             return rv;
@@ -92,8 +114,9 @@ namespace divine::mc::impl
         {
             if ( equal_fastpath( a, b ) )
                 return true;
-            else
-                return mem::compare( _h1, _h2, _root, _root ) == 0;
+
+            mem::NoopCmp< vm::HeapPointer > cb;
+            return mem::compare( _h1, _h2, _root, _root, _v1, _v2, cb ) == 0;
         }
 
         bool equal_symbolic( Snapshot a, Snapshot b ) const
@@ -103,7 +126,7 @@ namespace divine::mc::impl
 
             PairExtract extract;
 
-            if ( mem::compare( _h1, _h2, _root, _root, extract ) != 0 )
+            if ( mem::compare( _h1, _h2, _root, _root, _v1, _v2, extract ) != 0 )
                 return false;
 
             if ( extract.pairs.empty() )
@@ -112,10 +135,125 @@ namespace divine::mc::impl
             return _solver.equal( this->_path, extract.pairs, _h1, _h2 );
         }
 
-        auto hash( Snapshot s ) const
+        /* A cheap fingerprint of the memory near 'ptr': the (cached) content
+         * hashes of the objects at most 'depth' pointers away. Like the state
+         * hash, it does not depend on the object identifiers. */
+        template< typename Heap >
+        brq::hash64_t fingerprint( Heap &heap, vm::GenericPointer ptr, int depth ) const
+        {
+            if ( !ptr.heap() )
+                return ptr.object();
+
+            auto i = heap.ptr2i( ptr.object() );
+            if ( !heap.valid( i ) )
+                return 0;
+
+            auto [ data, pointers ] = heap.summary( ptr.object(), i );
+            brq::hash_state state( data );
+
+            if ( depth && pointers && heap.size( i ) <= 64 * 1024 )
+            {
+                mem::NopState nop;
+                auto ptr_cb = [&]( uint32_t obj )
+                {
+                    state.update_aligned( fingerprint( heap, vm::GenericPointer( obj ), depth - 1 ) );
+                };
+                heap.hash( ptr.object(), nop, ptr_cb );
+            }
+
+            return state.hash();
+        }
+
+        /* Symmetry reduction. The items of the _symmetric array (the task
+         * table of DiOS, announced by _VM_T_Symmetric) can be permuted without
+         * changing the behaviour of the program. Before a snapshot is taken,
+         * the array is sorted by the fingerprints of the items (i.e. of the top
+         * of the stack of each thread), so that states which only differ in
+         * the order of otherwise identical threads turn into the same state.
+         * Items with equal fingerprints keep their order; this may cost some
+         * reduction, but the states are still compared exactly. Returns true
+         * if the heap was changed. */
+        template< typename Heap >
+        bool canonicalise( Heap &heap ) const
+        {
+            if ( _symmetric.null() || !heap.valid( _symmetric ) )
+                return false;
+
+            using PointerV = vm::value::Pointer;
+            int count = heap.size( _symmetric ) / vm::PointerBytes;
+            std::vector< std::pair< brq::hash64_t, PointerV > > items( count );
+            auto p = _symmetric;
+
+            for ( int i = 0; i < count; ++i )
+            {
+                p.offset( i * vm::PointerBytes );
+                heap.read( p, items[ i ].second );
+                items[ i ].first = fingerprint( heap, items[ i ].second.cooked(), 2 );
+            }
+
+            auto by_fp = []( auto &a, auto &b ) { return a.first < b.first; };
+            if ( std::is_sorted( items.begin(), items.end(), by_fp ) )
+                return false;
+
+            std::stable_sort( items.begin(), items.end(), by_fp );
+            for ( int i = 0; i < count; ++i )
+            {
+                p.offset( i * vm::PointerBytes );
+                heap.write( p, items[ i ].second );
+            }
+
+            return true;
+        }
+
+        /* Compare the parts of the two snapshots which can be reached from
+         * the root without passing through the object 'skip' (which is
+         * considered equal in both). Used by partial order reduction to
+         * check that a step did not change anything outside of the (private
+         * memory of the) thread which took it. */
+        bool equal_except( Snapshot a, Snapshot b, vm::HeapPointer skip ) const
+        {
+            _h1.restore( _pool, a ), _h2.restore( _pool, b );
+            _v1.clear(), _v2.clear();
+            _v1.insert( skip.object(), 0 );
+            _v2.insert( skip.object(), 0 );
+
+            int seq = 1;
+            mem::NoopCmp< vm::HeapPointer > cb;
+            return mem::compare( _h1, _h2, _root, _root, _v1, _v2, seq, cb ) == 0;
+        }
+
+        /* Computing the hash of a snapshot means traversing the entire heap,
+         * hence the result is remembered in a slot attached to the snapshot
+         * (see prepare(), which must have been called on the snapshot). Every
+         * snapshot is hashed right before it is inserted into a table, so the
+         * slot is valid for any snapshot that is found in one; a zero slot
+         * only means that the hash has not been computed yet. Users which
+         * can not prepare their snapshots must turn the cache off. */
+        brq::hash64_t hash( Snapshot s ) const
         {
             _h1.restore( _pool, s );
-            return mem::hash( _h1, _root );
+            auto h = mem::hash( _h1, _root, _v1 );
+            if ( cache )
+                remember( s, h );
+            return h;
+        }
+
+        void remember( Snapshot s, brq::hash64_t h ) const
+        {
+            hash_slot( s ).store( h, std::memory_order_release );
+        }
+
+        brq::hash64_t stored_hash( Snapshot s ) const
+        {
+            return cache ? hash_slot( s ).load( std::memory_order_acquire ) : 0;
+        }
+
+        template< typename Cell >
+        brq::hash64_t rehash( Cell &cell ) const
+        {
+            auto s = cell.fetch();
+            auto h = stored_hash( s );
+            return h ? h : hash( s );
         }
     };
 }
@@ -134,6 +272,7 @@ namespace divine::mc
 
         void prepare( Snapshot s )
         {
+            Super::prepare( s );
             _sym_next.materialise( s, sizeof( Snapshot ) );
         }
 
@@ -145,6 +284,22 @@ namespace divine::mc
             : Super( o, pool, solver ), _sym_next( o._sym_next )
         {}
 
+        /* With subsumption, a new state (in _h2) is also considered a match if
+         * it is covered by the stored one (in _h1), i.e. each of its instances
+         * is an instance of the stored state. No state needs to be removed
+         * from the _sym_next chain: a stored state which is covered by a new
+         * one stays where it is (it has been explored already), the new state
+         * is appended, and only states with different explicit parts (or a
+         * different hash) are ever kept apart. When overwriting (i.e. when a
+         * counterexample is being reconstructed), states must be equal. */
+        bool covered( smt::solver::SymPairs &pairs ) const
+        {
+            if ( this->subsume && !this->overwrite )
+                return this->_solver.subsumes( this->_path, pairs, this->_h1, this->_h2 );
+            else
+                return this->_solver.equal( this->_path, pairs, this->_h1, this->_h2 );
+        }
+
         template< typename Cell >
         typename Cell::pointer match( Cell &cell, Snapshot b, mem::hash64_t h ) const
         {
@@ -163,10 +318,11 @@ namespace divine::mc
             {
                 impl::PairExtract extract;
 
-                if ( mem::compare( this->_h1, this->_h2, this->_root, this->_root, extract ) != 0 )
+                if ( mem::compare( this->_h1, this->_h2, this->_root, this->_root,
+                                   this->_v1, this->_v2, extract ) != 0 )
                     return nullptr;
 
-                if ( this->_solver.equal( this->_path, extract.pairs, this->_h1, this->_h2 ) )
+                if ( covered( extract.pairs ) )
                 {
                     if ( this->overwrite )
                     {
@@ -203,6 +359,9 @@ namespace divine::mc
         template< typename Cell >
         typename Cell::pointer match( Cell &a, Snapshot b, mem::hash64_t h ) const
         {
+            if ( auto ah = this->stored_hash( a.fetch() ); ah && ah != h )
+                return nullptr;
+
             if ( !this->equal_explicit( a.fetch(), b ) )
                 return nullptr;
 
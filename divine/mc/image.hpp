@@ -0,0 +1,164 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <brick-except>
+
+#include <string>
+#include <cstring>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Checkpoint images, used to save a stopped verification job to a file and to
+ * resume it later. An image is a sequence of small scalar records (written
+ * with put() and read back with get(), in the same order) interleaved with
+ * page-aligned blocks of raw memory. The blocks are the slabs of the memory
+ * pools: when the image is loaded, they are mapped (copy-on-write) straight
+ * from the file, so that only the parts which are actually used are ever read
+ * back in. */
+
+namespace divine::mc::image
+{
+    static constexpr char magic[ 8 ] = { 'D', 'I', 'V', 'I', 'M', 'G', '0', '1' };
+
+    static inline size_t pagesize() { return ::sysconf( _SC_PAGESIZE ); }
+
+    /* The image is written into a temporary file, which only replaces the
+     * target by commit(): a crash while writing a checkpoint leaves the
+     * previous one intact. */
+    struct Writer
+    {
+        std::string _path, _tmp;
+        int _fd;
+        off_t _off = 0;
+
+        Writer( std::string path ) : _path( path ), _tmp( path + ".part" )
+        {
+            _fd = ::open( _tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+            if ( _fd < 0 )
+                brq::raise< brq::system_error >() << "creating " << _tmp;
+            write( magic, sizeof( magic ) );
+        }
+
+        Writer( const Writer & ) = delete;
+        ~Writer() { if ( _fd >= 0 ) ::close( _fd ), ::unlink( _tmp.c_str() ); }
+
+        void write( const void *data, size_t size )
+        {
+            auto ptr = static_cast< const char * >( data );
+            while ( size )
+            {
+                auto res = ::write( _fd, ptr, size );
+                if ( res < 0 )
+                    brq::raise< brq::system_error >() << "writing " << _tmp;
+                ptr += res, size -= res, _off += res;
+            }
+        }
+
+        template< typename T >
+        void put( const T &t )
+        {
+            static_assert( std::is_trivially_copyable_v< T > );
+            write( &t, sizeof( T ) );
+        }
+
+        void block( const void *data, size_t size )
+        {
+            if ( size_t pad = _off % pagesize() )
+            {
+                /* a sparse gap, which reads back as zeroes */
+                if ( ::lseek( _fd, pagesize() - pad, SEEK_CUR ) < 0 )
+                    brq::raise< brq::system_error >() << "seeking in " << _tmp;
+                _off += pagesize() - pad;
+            }
+            write( data, size );
+        }
+
+        void commit()
+        {
+            if ( ::ftruncate( _fd, _off ) || ::fsync( _fd ) || ::close( _fd ) )
+                brq::raise< brq::system_error >() << "writing " << _tmp;
+            _fd = -1;
+            if ( ::rename( _tmp.c_str(), _path.c_str() ) )
+                brq::raise< brq::system_error >() << "renaming " << _tmp << " to " << _path;
+        }
+    };
+
+    struct Reader
+    {
+        std::string _path;
+        int _fd;
+        off_t _off = 0, _size;
+
+        Reader( std::string path ) : _path( path )
+        {
+            struct stat st;
+            _fd = ::open( path.c_str(), O_RDONLY );
+            if ( _fd < 0 || ::fstat( _fd, &st ) )
+                brq::raise< brq::system_error >() << "opening " << path;
+            _size = st.st_size;
+
+            char m[ sizeof( magic ) ];
+            read( m, sizeof( m ) );
+            if ( std::memcmp( m, magic, sizeof( magic ) ) )
+                brq::raise() << path << " is not a checkpoint image";
+        }
+
+        Reader( const Reader & ) = delete;
+        ~Reader() { ::close( _fd ); }
+
+        void truncated() { brq::raise() << "checkpoint image " << _path << " is truncated"; }
+
+        void read( void *data, size_t size )
+        {
+            if ( _off + off_t( size ) > _size )
+                truncated();
+            if ( ::pread( _fd, data, size, _off ) != ssize_t( size ) )
+                brq::raise< brq::system_error >() << "reading " << _path;
+            _off += size;
+        }
+
+        template< typename T >
+        T get()
+        {
+            static_assert( std::is_trivially_copyable_v< T > );
+            T t;
+            read( &t, sizeof( T ) );
+            return t;
+        }
+
+        /* The mapping is private and writable, and can be released using
+         * munmap (i.e. brick::mmap::MMap::drop) like any other pool block. */
+        void *block( size_t size )
+        {
+            if ( size_t pad = _off % pagesize() )
+                _off += pagesize() - pad;
+            if ( _off + off_t( size ) > _size )
+                truncated();
+
+            void *mem = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, _off );
+            if ( mem == MAP_FAILED )
+                brq::raise< brq::system_error >() << "mapping " << _path;
+            _off += size;
+            return mem;
+        }
+    };
+}
@@ -37,6 +37,9 @@ struct Job : ss::Job
     std::function< int64_t() > queuesize = []() { return 0; };
     std::shared_ptr< ss::Job > _search;
 
+    std::string _checkpoint; /* image file, see checkpoint() */
+    std::chrono::seconds _checkpoint_period = std::chrono::seconds( 0 );
+
     template< typename Monitor >
     void start( int threads, Monitor monit )
     {
@@ -51,9 +54,15 @@ struct Job : ss::Job
         _monitor = monit;
     }
 
+    void checkpoint( std::string file, std::chrono::seconds period )
+    {
+        _checkpoint = file;
+        _checkpoint_period = period;
+    }
+
     void wait() override
     {
-        auto clock = std::chrono::steady_clock::now();
+        auto clock = std::chrono::steady_clock::now(), saved = clock;
         auto search = std::async( [&] { _search->wait(); } );
         auto cleanup = [&] { _search->stop(); if ( _monitor ) _monitor( true ); };
         using brick::shmem::wait;
@@ -63,6 +72,21 @@ struct Job : ss::Job
             clock += std::chrono::milliseconds( 500 );
             if ( _monitor )
                 try { _monitor( false ); } catch ( ... ) { cleanup(); throw; };
+
+            if ( _checkpoint.empty() || clock - saved < _checkpoint_period )
+                continue;
+
+            /* stop the search, save it and carry on from where it stopped; if
+             * it finished in the meantime, the next wait() picks that up */
+            saved = clock;
+            if ( search.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready )
+                continue;
+            _search->stop();
+            try {
+                search.get();
+                if ( checkpoint() )
+                    search = std::async( [&] { _search->wait(); } );
+            } catch ( ... ) { cleanup(); throw; };
         }
     }
 
@@ -77,6 +101,13 @@ struct Job : ss::Job
     virtual Result result() { return Result::None; }
     virtual PoolStats poolstats() { return PoolStats(); }
     virtual HashStats hashstats() { return HashStats(); }
+    virtual double omissions() { return 0; } /* expected number of states lost to compact storage */
+
+    /* Save the (stopped) job into the _checkpoint image and restart the
+     * search; returns false if there is nothing left to search. A job can be
+     * resumed from an image before it is started. */
+    virtual bool checkpoint() { return false; }
+    virtual void resume( std::string ) { UNREACHABLE( "this job cannot be resumed" ); }
     virtual void dbg_fill( DbgCtx & ) {}
     virtual void start( int ) override = 0;
     virtual void start( int, std::string ) override = 0;
@@ -35,6 +35,10 @@ namespace divine::mc
 #if OPT_STP
             if ( solver == "stp" )
                 return std::make_shared< Job_< Next, mc::STPBuilder > >( bc, next );
+#endif
+#if OPT_STP && OPT_Z3
+            if ( solver == "portfolio" )
+                return std::make_shared< Job_< Next, mc::PortfolioBuilder > >( bc, next );
 #endif
             if ( brq::starts_with( solver, "smtlib" ) )
             {
@@ -42,7 +46,7 @@ namespace divine::mc
                 if ( solver == "smtlib" || solver == "smtlib:z3" )
                     cmd = { "z3", "-in", "-smt2" };
                 else if ( solver == "smtlib:boolector" )
-                    cmd = { "boolector", "--smt2" };
+                    cmd = { "boolector", "--smt2", "--incremental" };
                 else
                     cmd = { std::string( solver, 7, std::string::npos ) };
                 return std::make_shared< Job_< Next, mc::SMTLibBuilder > >( bc, next, cmd );
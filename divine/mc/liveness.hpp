@@ -23,6 +23,9 @@
 #include <divine/mc/builder.hpp>
 #include <divine/mc/trace.hpp>
 #include <brick-query>
+#include <brick-shmem>
+
+#include <map>
 
 namespace divine {
 namespace mc {
@@ -238,6 +241,302 @@ struct NestedDFS : ss::Job
     void stop() override {}
 };
 
+/* One Way Catch Them Young (Černá & Pelánek, 2003), a parallel accepting
+ * cycle detection algorithm. Starting with all reachable states, it repeats
+ * two phases until a fixpoint is reached: 'reset' removes all states which are
+ * not reachable from the target of an accepting edge with its source in the
+ * set, and 'eliminate' removes states with no predecessors in the set
+ * (recursively). An accepting cycle exists iff the final set is non-empty.
+ * Acceptance is a property of edges (labels) here, so it is kept on the edges:
+ * a state only records that it has an accepting outgoing edge, and the reset
+ * seeds are the targets of such edges. Each phase is a parallel search over
+ * the (already stored) state space; the per-state data lives in a SlavePool,
+ * like the flags of NestedDFS. */
+template< typename Builder >
+struct OWCTY : ss::Job
+{
+    using State = typename Builder::State;
+    using Label = typename Builder::Label;
+    using Snapshot = vm::CowHeap::Snapshot;
+    using MasterPool = typename vm::CowHeap::SnapPool;
+    using SlavePool = brick::mem::SlavePool< MasterPool >;
+    using States = std::shared_ptr< std::vector< State > >;
+
+    Builder _builder;
+    SlavePool _flagPool;
+    int _threads = 1;
+
+    struct StateFlags
+    {
+        std::atomic< Snapshot > parent;
+        std::atomic< int > pred, iteration;
+        std::atomic< bool > accepting, in_set; /* accepting: has an accepting out-edge */
+    };
+
+    std::vector< State > _states;
+    brick::shmem::SpinLock _states_lock;
+    std::atomic< int64_t > _size;
+    std::atomic< bool > _stop;
+    bool _fixpoint = false;
+
+    std::optional< State > _error, _error_to;
+    Label _error_label;
+
+    explicit OWCTY( Builder builder )
+        : _builder( builder ), _flagPool( _builder.pool() ), _size( 0 ), _stop( false )
+    {}
+
+    StateFlags &flags( State s ) { return *_flagPool.machinePointer< StateFlags >( s.snap ); }
+
+    void init_state( State s, Snapshot parent )
+    {
+        _flagPool.materialise( s.snap, sizeof( StateFlags ) );
+        auto &f = *new ( &flags( s ) ) StateFlags();
+        f.parent = parent;
+        std::lock_guard< brick::shmem::SpinLock > _lock( _states_lock );
+        _states.push_back( s );
+    }
+
+    template< typename Edge >
+    void search( States seeds, Edge edge )
+    {
+        Seeded< Builder > b( _builder, seeds );
+        ss::search( ss::Order::PseudoBFS, b, _threads,
+                    ss::listen( edge, []( auto ) { return ss::Listen::Process; } ) );
+    }
+
+    /* Explore the state space and set up the flags. Only the thread which
+     * stored a state may initialise its flags; the source of an edge has
+     * always been initialised before it is expanded. */
+    void reachability()
+    {
+        _builder.initials( [&]( State s ) { init_state( s, Snapshot() ); } );
+
+        ss::search( ss::Order::PseudoBFS, _builder, _threads, ss::listen(
+            [&]( State from, State to, const Label &label, bool isnew )
+            {
+                if ( _stop )
+                    return ss::Listen::Terminate;
+                if ( label.error )
+                {
+                    std::lock_guard< brick::shmem::SpinLock > _lock( _states_lock );
+                    if ( !_error )
+                        _error = from, _error_to = to, _error_label = label;
+                    return ss::Listen::Terminate;
+                }
+                if ( isnew )
+                    init_state( to, from.snap );
+                if ( label.accepting )
+                    flags( from ).accepting = true;
+                return ss::Listen::AsNeeded;
+            } ) );
+
+        for ( auto s : _states )
+            flags( s ).in_set = true;
+        _size = _states.size();
+    }
+
+    /* Remove states that are not reachable from the target of an accepting
+     * edge whose source is in the set, and compute the number of predecessors
+     * (within the set) on the way. */
+    void reset( int iteration )
+    {
+        auto sources = std::make_shared< std::vector< State > >();
+        auto seeds = std::make_shared< std::vector< State > >();
+
+        for ( auto s : _states )
+        {
+            auto &f = flags( s );
+            f.pred = 0;
+            if ( f.in_set && f.accepting )
+                sources->push_back( s );
+        }
+
+        search( sources, [&]( State, State to, const Label &label, bool isnew )
+        {
+            ASSERT( !isnew );
+            auto &f = flags( to );
+            if ( _stop )
+                return ss::Listen::Terminate;
+            if ( label.accepting && f.in_set && f.iteration.exchange( iteration ) != iteration )
+            {
+                std::lock_guard< brick::shmem::SpinLock > _lock( _states_lock );
+                seeds->push_back( to );
+            }
+            return ss::Listen::Ignore;
+        } );
+
+        search( seeds, [&]( State, State to, const Label &, bool isnew )
+        {
+            ASSERT( !isnew );
+            auto &f = flags( to );
+            if ( _stop )
+                return ss::Listen::Terminate;
+            if ( !f.in_set )
+                return ss::Listen::Ignore;
+            ++ f.pred;
+            return f.iteration.exchange( iteration ) == iteration
+                ? ss::Listen::Ignore : ss::Listen::Process;
+        } );
+
+        int64_t size = 0;
+        for ( auto s : _states )
+        {
+            auto &f = flags( s );
+            if ( f.in_set && f.iteration != iteration )
+                f.in_set = false;
+            size += f.in_set;
+        }
+        _size = size;
+    }
+
+    /* Recursively remove states with no predecessors in the set. */
+    void eliminate()
+    {
+        auto seeds = std::make_shared< std::vector< State > >();
+
+        for ( auto s : _states )
+        {
+            auto &f = flags( s );
+            if ( f.in_set && !f.pred )
+                seeds->push_back( s ), f.in_set = false;
+        }
+
+        search( seeds, [&]( State, State to, const Label &, bool )
+        {
+            auto &f = flags( to );
+            if ( _stop )
+                return ss::Listen::Terminate;
+            if ( !f.in_set || -- f.pred )
+                return ss::Listen::Ignore;
+            f.in_set = false;
+            return ss::Listen::Process;
+        } );
+
+        int64_t size = 0;
+        for ( auto s : _states )
+            size += flags( s ).in_set;
+        _size = size;
+    }
+
+    /* The final set is non-empty: find an accepting edge which lies on a
+     * cycle within the set. This is sequential, but the set is usually tiny
+     * compared to the whole state space. */
+    std::deque< State > find_cycle()
+    {
+        for ( auto seed : _states )
+        {
+            if ( !flags( seed ).in_set || !flags( seed ).accepting )
+                continue;
+
+            std::map< Snapshot, Snapshot > parent;
+            std::deque< State > open, cycle;
+            std::optional< State > closing;
+
+            _builder.edges( seed, [&]( State to, const Label &label, bool )
+            {
+                if ( closing || !label.accepting || !flags( to ).in_set )
+                    return;
+                if ( to == seed )
+                    closing = seed;
+                else if ( parent.emplace( to.snap, seed.snap ).second )
+                    open.push_back( to );
+            } );
+
+            while ( !open.empty() && !closing )
+            {
+                auto v = open.front();
+                open.pop_front();
+                _builder.edges( v, [&]( State to, const Label &, bool )
+                {
+                    if ( closing || !flags( to ).in_set )
+                        return;
+                    if ( to == seed )
+                        closing = v;
+                    else if ( parent.emplace( to.snap, v.snap ).second )
+                        open.push_back( to );
+                } );
+            }
+
+            if ( !closing )
+                continue;
+
+            cycle.push_back( seed );
+            for ( auto s = closing->snap; s != seed.snap; s = parent[ s ] )
+                cycle.push_front( State{ s } );
+            cycle.push_front( seed );
+            return cycle;
+        }
+
+        UNREACHABLE( "OWCTY: no accepting cycle in a non-empty set" );
+    }
+
+    template< typename Trace >
+    void prefix( Trace &trace, State to )
+    {
+        for ( auto s = to.snap; s != _builder._d.initial.snap; s = flags( State{ s } ).parent )
+            trace.emplace_front( s, std::nullopt );
+        trace.emplace_front( _builder._d.initial.snap, std::nullopt );
+    }
+
+    template< typename Trace >
+    Trace counterexample()
+    {
+        Trace trace;
+
+        if ( _error )
+        {
+            prefix( trace, *_error );
+            trace.emplace_back( _error_to->snap, _error_label );
+            return trace;
+        }
+
+        auto cycle = find_cycle();
+        prefix( trace, cycle.front() );
+        cycle.pop_front();
+        for ( auto s : cycle )
+            trace.emplace_back( s.snap, std::nullopt );
+        return trace;
+    }
+
+    bool error_found() { return _error || ( _fixpoint && _size > 0 ); }
+
+    void run()
+    {
+        reachability();
+
+        int64_t previous = -1;
+        for ( int i = 1; !_error && !_stop && _size && _size != previous; ++i )
+        {
+            previous = _size;
+            reset( i );
+            eliminate();
+        }
+
+        _fixpoint = !_stop;
+    }
+
+    std::future< void > _thread;
+
+    void start( int thread_count ) override
+    {
+        _threads = thread_count;
+        _thread = std::async( [&]{ run(); } );
+    }
+
+    void start( int thread_count, std::string ) override
+    {
+        start( thread_count );
+    }
+
+    void wait() override
+    {
+        _thread.get();
+    }
+
+    void stop() override { _stop = true; }
+};
+
 template< typename Next, typename Builder_ = ExplicitBuilder >
 struct Liveness : Job
 {
@@ -259,6 +558,9 @@ struct Liveness : Job
 
     void start( int threads ) override
     {
+        if ( threads > 1 )
+            return start_owcty( threads );
+
         auto *search = new NestedDFS( _ex );
         _search.reset( search );
         stats = [=] { return std::pair( _ex._d.total_states->load(), _ex._d.total_instructions->load() ); };
@@ -298,6 +600,17 @@ struct Liveness : Job
         search->start( threads );
     }
 
+    void start_owcty( int threads )
+    {
+        auto *search = new OWCTY( _ex );
+        _search.reset( search );
+        stats = [=] { return std::pair( _ex._d.total_states->load(), _ex._d.total_instructions->load() ); };
+        queuesize = [=] { return search->_size.load(); };
+        _get_trace = [=] { return search->template counterexample< StateTrace >(); };
+        _error_found = [=] { return search->error_found(); };
+        search->start( threads );
+    }
+
     void start( int threads, std::string alg ) override
     {
         start( threads );
@@ -314,7 +627,10 @@ struct Liveness : Job
 
     Trace ce_trace() override
     {
-        return _error_found() ? mc::trace( _ex, _get_trace() ) : mc::Trace();
+        if ( !_error_found() )
+            return mc::Trace();
+        typename Builder::Debug dbg( _ex );
+        return mc::trace( dbg, _get_trace() );
     }
 
     virtual PoolStats poolstats() override
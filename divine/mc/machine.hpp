@@ -440,7 +440,9 @@ namespace divine::mc::machine
         }
 
         auto &hasher() { return _hasher; }
-        graph_search() : _hasher( _pool, _solver ) {}
+        /* the snapshots are created (in two different pools) by the compute
+         * modules, which can not prepare them for the hash cache */
+        graph_search() : _hasher( _pool, _solver ) { _hasher.cache = false; }
 
         std::pair< Snapshot, bool > store( Snapshot snap, HT &table )
         {
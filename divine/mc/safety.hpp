@@ -22,6 +22,10 @@
 #include <divine/mc/job.hpp>
 #include <divine/mc/trace.hpp>
 #include <divine/mc/bitcode.hpp>
+#include <divine/mc/builder.hpp>
+#include <divine/mc/image.hpp>
+#include <divine/ss/external.hpp>
+#include <divine/ss/distributed.hpp>
 
 namespace divine::mc
 {
@@ -29,68 +33,85 @@ namespace divine::mc
 template< typename Next, typename Builder >
 struct Safety : Job
 {
-    using Parent = std::atomic< vm::CowHeap::Snapshot >;
+    using Snapshot = vm::CowHeap::Snapshot;
     using MasterPool = typename vm::CowHeap::SnapPool;
     using SlavePool = brick::mem::SlavePool< MasterPool >;
     using StateTrace = mc::StateTrace< Builder >;
+    using State = typename Builder::State;
+
+    /* per-state data; 'expanded' is only maintained for checkpoints */
+    struct Ext
+    {
+        std::atomic< Snapshot > parent;
+        std::atomic< bool > expanded;
+    };
 
     Builder _ex;
     SlavePool _ext;
     Next _next;
 
     bool _error_found;
-    typename Builder::State _error, _error_to;
+    State _error, _error_to;
     typename Builder::Label _error_label;
+    std::function< std::vector< State >( State ) > _path;
+
+    int _threads = 0;
+    std::string _alg;
+    std::shared_ptr< std::vector< State > > _seeds; /* resume the search from these */
+
+    Ext &ext( Snapshot s ) { return *_ext.machinePointer< Ext >( s ); }
 
-    auto make_search()
+    /* Only the thread which allocated a snapshot may materialise its slot in
+     * _ext. The distributed search hands each successor over to the peer
+     * which owns it, and that peer calls the listener, hence the slot is
+     * materialised by the sender, before the state leaves the thread. */
+    struct Sender : Builder
     {
-        return ss::make_search(
-            _ex, ss::listen(
-                [&]( auto from, auto to, auto label, bool isnew )
+        SlavePool *_ext;
+        Sender( const Builder &b, SlavePool *ext ) : Builder( b ), _ext( ext ) {}
+
+        template< typename Y >
+        void edges( State from, Y yield )
+        {
+            Builder::edges( from, [&]( auto to, auto label, bool isnew )
+            {
+                _ext->materialise( to.snap, sizeof( Ext ) );
+                yield( to, label, isnew );
+            } );
+        }
+    };
+
+    auto listener()
+    {
+        return ss::listen(
+            [&]( auto from, auto to, auto label, bool isnew )
+            {
+                if ( isnew )
                 {
-                    if ( isnew )
-                    {
-                        _ext.materialise( to.snap, sizeof( from ) );
-                        Parent &parent = *_ext.machinePointer< Parent >( to.snap );
-                        parent = from.snap;
-                    }
-                    if ( label.error )
-                    {
-                        _error_found = true;
-                        _error = from; /* the error edge may not be the parent of 'to' */
-                        _error_to = to;
-                        _error_label = label;
-                        return ss::Listen::Terminate;
-                    }
-                    return _next.edge( from, to, label, isnew );
-                },
-                [&]( auto st ) { return _next.state( st ); } ) );
+                    if ( !_ex._d.partitioned ) /* see Sender */
+                        _ext.materialise( to.snap, sizeof( Ext ) );
+                    ext( to.snap ).parent = from.snap;
+                }
+                if ( !_checkpoint.empty() )
+                    ext( from.snap ).expanded.store( true, std::memory_order_relaxed );
+                if ( label.error )
+                {
+                    _error_found = true;
+                    _error = from; /* the error edge may not be the parent of 'to' */
+                    _error_to = to;
+                    _error_label = label;
+                    return ss::Listen::Terminate;
+                }
+                return _next.edge( from, to, label, isnew );
+            },
+            [&]( auto st ) { return _next.state( st ); } );
     }
 
+    auto make_search() { return ss::make_search( _ex, listener() ); }
+
     auto make_search( std::string alg )
     {
-        auto s = ss::make_search(
-            _ex, ss::listen(
-                [&]( auto from, auto to, auto label, bool isnew )
-                {
-                    if ( isnew )
-                    {
-                        _ext.materialise( to.snap, sizeof( from ) );
-                        Parent &parent = *_ext.machinePointer< Parent >( to.snap );
-                        parent = from.snap;
-                    }
-                    if ( label.error )
-                    {
-                        _error_found = true;
-                        _error = from; /* the error edge may not be the parent of 'to' */
-                        _error_to = to;
-                        _error_label = label;
-                        return ss::Listen::Terminate;
-                    }
-                    return _next.edge( from, to, label, isnew );
-                },
-                [&]( auto st ) { return _next.state( st ); } ));
-
+        auto s = make_search();
         s.set_alg ( alg );
         return s;
     }
@@ -102,18 +123,25 @@ struct Safety : Job
           _next( next ),
           _error_found( false )
     {
+        _ex.storage( bc->storage(), bc->storage_size() );
+        if ( bc->tree_compression() )
+            _ex.tree_compression();
+        _ex.por( bc->por() );
+        _ex.symmetry( bc->symmetry() );
+        _ex.subsumption( bc->subsumption() );
         _ex.start();
+        if ( _ex.pool().valid( _ex._d.initial.snap ) )
+            _ext.materialise( _ex._d.initial.snap, sizeof( Ext ) );
     }
 
-    void start( int threads ) override
+    template< typename Search >
+    void run( Search *search, int threads, std::function< int64_t() > states )
     {
-        using Search = decltype( make_search() );
-        _search.reset( new Search( std::move( make_search() ) ) );
-        Search *search = dynamic_cast< Search * >( _search.get() );
+        _search.reset( search );
 
         stats = [=]()
         {
-            int64_t st = _ex._d.total_states->load();
+            int64_t st = _ex._d.total_states->load() + states();
             int64_t mip = _ex._d.total_instructions->load();
             search->ws_each( [&]( auto &bld, auto & )
             {
@@ -124,29 +152,53 @@ struct Safety : Job
         };
         queuesize = [=]() { return search->qsize(); };
 
-        search->start( threads );
+        search->start( threads, _alg );
+    }
+
+    void start( int threads ) override
+    {
+        start( threads, "bfs" );
     }
 
     void start( int threads, std::string alg ) override
     {
-        using Search = decltype( make_search( alg ) );
-        _search.reset( new Search( std::move( make_search( alg ) ) ) );
-        Search *search = dynamic_cast< Search * >( _search.get() );
+        _threads = threads;
+        _alg = alg;
 
-        stats = [=]()
+        if ( _seeds )
         {
-            int64_t st = _ex._d.total_states->load();
-            int64_t mip = _ex._d.total_instructions->load();
-            search->ws_each( [&]( auto &bld, auto & )
-            {
-                st += bld._d.local_states;
-                mip += bld._d.local_instructions;
-            } );
-            return std::make_pair( st, mip );
-        };
-        queuesize = [=]() { return search->qsize(); };
+            if ( alg == "distributed" )
+                brq::raise() << "the distributed search order can not be resumed from a checkpoint";
+            auto search = ss::make_search( Seeded< Builder >( _ex, _seeds ), listener() );
+            search.set_alg( alg );
+            _seeds.reset();
+            return run( new decltype( search )( search ), threads, []() { return 0; } );
+        }
+
+        if ( alg == "distributed" )
+        {
+            if ( _ex._d.storage != storage::exact || _ex._d.por )
+                brq::raise() << "the distributed search order requires exact storage and no --por";
+
+            /* each peer keeps its own table, hence the builder must not store
+             * the states; the initial state has been counted by the builder */
+            _ex.partitioned( true );
+            auto search = new ss::Distributed< Sender, decltype( listener() ) >( Sender( _ex, &_ext ),
+                                                                                 listener() );
+            return run( search, threads, [=]() { auto n = search->states(); return n ? n - 1 : 0; } );
+        }
 
-        search->start( threads );
+        if ( _ex.external() )
+        {
+            /* the builder does not count states, since it can't tell which are new */
+            auto search = new ss::External< Builder, decltype( listener() ) >( _ex, listener() );
+            search->budget( _ex._d.storage_size );
+            _path = [=]( auto st ) { return search->path( st ); };
+            return run( search, threads, [=]() { return search->states(); } );
+        }
+
+        using Search = decltype( make_search( alg ) );
+        run( new Search( make_search( alg ) ), threads, []() { return 0; } );
     }
 
     Trace ce_trace() override
@@ -156,14 +208,72 @@ struct Safety : Job
 
         StateTrace rv;
         rv.emplace_front( _error_to.snap, _error_label );
-        auto i = _error.snap;
-        while ( i != _ex._d.initial.snap )
+
+        if ( _path )
         {
-            rv.emplace_front( i, std::nullopt );
-            i = *_ext.machinePointer< vm::CowHeap::Snapshot >( i );
+            auto path = _path( _error );
+            for ( auto st = path.rbegin(); st != path.rend(); ++st )
+                rv.emplace_front( st->snap, std::nullopt );
+        }
+        else
+        {
+            auto i = _error.snap;
+            while ( i != _ex._d.initial.snap )
+            {
+                rv.emplace_front( i, std::nullopt );
+                i = ext( i ).parent;
+            }
+            rv.emplace_front( _ex._d.initial.snap, std::nullopt );
         }
-        rv.emplace_front( _ex._d.initial.snap, std::nullopt );
-        return mc::trace( _ex, rv );
+
+        _ex.storage( storage::exact ); /* the trace is re-discovered by a search */
+        _ex.partitioned( false );
+        typename Builder::Debug dbg( _ex );
+        return mc::trace( dbg, rv );
+    }
+
+    double omissions() override { return _ex.omissions(); }
+
+    /* States which have been stored but not expanded yet. The search is only
+     * ever stopped between two expansions, hence these (together with the
+     * stored states) describe the stopped search completely. States without
+     * successors are never marked as expanded; they are simply expanded again
+     * after a restart. */
+    auto frontier()
+    {
+        auto f = std::make_shared< std::vector< State > >();
+        _ex.stored( [&]( State st ) { if ( !ext( st.snap ).expanded ) f->push_back( st ); } );
+        return f;
+    }
+
+    bool checkpoint() override
+    {
+        if ( _error_found )
+            return false;
+
+        auto f = frontier();
+        if ( f->empty() )
+            return false;
+
+        image::Writer img( _checkpoint );
+        img.put( _ex.fingerprint() );
+        _ext.save( img );
+        _ex.save( img );
+        img.commit();
+
+        _seeds = f;
+        start( _threads, _alg );
+        return true;
+    }
+
+    void resume( std::string file ) override
+    {
+        image::Reader img( file );
+        if ( img.get< brq::hash64_t >() != _ex.fingerprint() )
+            brq::raise() << file << " was saved from a different program or with different options";
+        _ext.load( img ); /* before the snapshot pool it is attached to */
+        _ex.load( img );
+        _seeds = frontier();
     }
 
     void dbg_fill( DbgCtx &dbg ) override { dbg.load( _ex.pool(), _ex.context() ); }
@@ -125,6 +125,21 @@ namespace divine::t_mc
             ASSERT( ex2.equal( i1.snap, i2.snap ) );
         }
 
+        TEST(debug_view)
+        {
+            auto bc = prog_int( "4", "*r - 1" );
+            mc::ExplicitBuilder ex( bc );
+            ex.start();
+            mc::ExplicitBuilder::Debug dbg( ex );
+            mc::builder::State i1, i2, s1, s2;
+            ex.initials( [&]( auto i ) { i1 = i; } );
+            dbg.initials( [&]( auto i ) { i2 = i; } );
+            ASSERT( i1 == i2 );
+            ex.edges( i1, [&]( auto s, auto, bool ) { s1 = s; } );
+            dbg.edges( i2, [&]( auto s, auto, bool isnew ) { s2 = s; ASSERT( !isnew ); } );
+            ASSERT( s1 == s2 );
+        }
+
         TEST(succ)
         {
             auto bc = prog_int( "4", "*r - 1" );
@@ -174,14 +174,14 @@ namespace divine::t_mc
 #endif
 
         template< typename... M >
-        void _search( std::shared_ptr< mc::BitCode > bc, int sc, int ec )
+        void _search( std::shared_ptr< mc::BitCode > bc, int sc, int ec, int threads = 1 )
         {
             brq::cons_list_t< mc::computer, M... > machines;
             int edgecount = 0, statecount = 0;
             auto edge = [&]( mc::event::edge e ) { ++edgecount; if ( e.is_new ) ++ statecount; };
             auto observe = [&]( auto & ... m )
             {
-                mc::weave( m... ).observe( edge ).start();
+                mc::weave( m... ).observe( edge ).start( threads );
             };
 
             machines.car().bc( bc );
@@ -207,6 +207,13 @@ namespace divine::t_mc
         TEST( branching4 ){ _search< GM >( prog_int( 4, "x - 1 - __vm_choose( 2 )" ), 4, 7 ); }
         TEST( branching5 ){ _search< GM >( prog_int( 0, "( x + __vm_choose( 2 ) ) % 5" ), 4, 10 ); }
         TEST( branching6 ){ _search< GM >( prog_int( 0, "( x + 1 + __vm_choose( 2 ) ) % 5" ), 4, 10 ); }
+
+        TEST( parallel )
+        {
+            _search< TM >( prog_int( 4, "x - 1 - __vm_choose( 2 )" ), 12, 12, 2 );
+            _search< GM >( prog_int( 4, "x - 1 - __vm_choose( 2 )" ), 4, 7, 2 );
+            _search< GM >( prog_int( 0, "( x + __vm_choose( 2 ) ) % 5" ), 4, 10, 3 );
+        }
     };
 
 }
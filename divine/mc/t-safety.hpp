@@ -40,5 +40,24 @@ namespace divine::t_mc
             ASSERT_EQ( edgecount, 4 );
             ASSERT_EQ( statecount, 5 );
         }
+
+        void compact( mc::storage mode )
+        {
+            auto bc = prog_int( "4", "*r - 1" );
+            bc->storage( mode, 1024 * 1024 );
+            int edgecount = 0, statecount = 0;
+            auto safe = mc::make_job< mc::Safety >(
+                bc, ss::passive_listen(
+                    [&]( auto, auto, auto ) { ++edgecount; },
+                    [&]( auto ) { ++statecount; } ) );
+            safe->start( 1 );
+            safe->wait();
+            ASSERT_EQ( edgecount, 4 );
+            ASSERT_EQ( statecount, 5 );
+            ASSERT( safe->omissions() < 1e-6 );
+        }
+
+        TEST( hash_compaction ) { compact( mc::storage::compact ); }
+        TEST( bitstate ) { compact( mc::storage::bitstate ); }
     };
 }
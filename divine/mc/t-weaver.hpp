@@ -65,6 +65,28 @@ namespace divine::t_mc
         void run( tq, task2 ) { ++t2; }
     };
 
+    struct task3 : mc::task::base
+    {
+        task3() : base( -1 ) {}
+    };
+
+    struct source : mc::machine_base
+    {
+        using tq = mc::task_queue< task1, task3 >;
+        void run( tq q, task1 t )
+        {
+            for ( int i = 0; i < t.i; ++i )
+                push( q, task3() );
+        }
+    };
+
+    struct sink : mc::machine_base
+    {
+        using tq = mc::task_queue< task3 >;
+        int count = 0;
+        void run( tq, task3 ) { ++count; }
+    };
+
     struct Weave
     {
         TEST( basic )
@@ -76,5 +98,41 @@ namespace divine::t_mc
             ASSERT_EQ( ctr.t1, 5 );
             ASSERT_EQ( ctr.t2, 4 );
         }
+
+        TEST( recycle )
+        {
+            mc::Weaver< base::tq, machine1, machine2 > weaver;
+            for ( int i = 0; i < 10000; ++i )
+            {
+                weaver.add< task1 >( 0 );
+                weaver.run();
+            }
+            ASSERT_EQ( weaver.delivered< task1 >(), 60000 );
+            ASSERT_EQ( weaver.delivered< task2 >(), 50000 );
+            auto st = weaver.mq_stats();
+            ASSERT_LT( st.total.count.held, 8 );
+            ASSERT_EQ( st.total.count.used, 1 );
+        }
+
+        TEST( parallel )
+        {
+            mc::Weaver< base::tq, machine1, machine2, counter > weaver;
+            weaver.add< task1 >( 3 );
+            weaver.run( 3 );
+            auto &ctr = weaver.machine< counter >();
+            ASSERT_EQ( ctr.t1, 5 );
+            ASSERT_EQ( ctr.t2, 4 );
+        }
+
+        TEST( sharded )
+        {
+            sink a, b, c;
+            auto weaver = mc::Weaver< source::tq >().extend( source() ).extend_ref( a, b, c );
+            weaver.add< task1 >( 300 );
+            weaver.run( 2 );
+            ASSERT_EQ( a.count, 100 );
+            ASSERT_EQ( b.count, 100 );
+            ASSERT_EQ( c.count, 100 );
+        }
     };
 }
@@ -18,7 +18,13 @@
 
 #pragma once
 #include <deque>
+#include <vector>
+#include <array>
+#include <utility>
+#include <future>
+#include <thread>
 #include <brick-cons>
+#include <brick-mem>
 
 namespace divine::mc::task
 {
@@ -49,8 +55,12 @@ namespace divine::mc
         static const size_t last_idx = byte_size - 1;
         uint8_t data[ byte_size ];
 
-        mq_block() : next( nullptr ), ptr( 0 ), ctr( 0 )
+        mq_block() { reset(); }
+
+        void reset()
         {
+            next = nullptr;
+            ptr = ctr = 0;
             data[ last_idx ] = 255;
         }
 
@@ -110,19 +120,73 @@ namespace divine::mc
         }
     };
 
+    /* Blocks which were consumed by a reader are kept here for reuse. The
+     * blocks are returned one at a time, but only ever taken all at once (by
+     * a buffer, which keeps them in a private stash), hence the lock-free
+     * stack is not prone to the ABA problem. Also keeps the statistics of
+     * all the queues which use the pool. */
+    struct mq_pool /* threads: shared by all readers and buffers */
+    {
+        std::atomic< mq_block * > _free;
+        std::atomic< int64_t > _allocated, _in_flight, _queued;
+
+        mq_pool() : _free( nullptr ), _allocated( 0 ), _in_flight( 0 ), _queued( 0 ) {}
+        ~mq_pool()
+        {
+            for ( auto b = take(); b; )
+                delete std::exchange( b, b->next.load() );
+        }
+
+        mq_block *make() { ++ _allocated; return new mq_block; }
+        mq_block *take() { return _free.exchange( nullptr ); }
+
+        void put( mq_block *b )
+        {
+            mq_block *top = _free.load();
+            do b->next.store( top );
+            while ( !_free.compare_exchange_weak( top, b ) );
+        }
+
+        /* count is the number of blocks; the bytes are only those used */
+        brick::mem::Stats stats() const
+        {
+            brick::mem::Stats st;
+            auto &i = st[ sizeof( mq_block ) ];
+            i.count.used = _in_flight;
+            i.count.held = _allocated;
+            i.bytes.used = _queued;
+            i.bytes.held = _allocated * sizeof( mq_block );
+            st.total.count = i.count;
+            st.total.bytes = i.bytes;
+            return st;
+        }
+    };
+
     template< typename TL >
     struct mq_reader /* threads: at most one reader per queue */
     {
         mq_block *to_read;
-        mq_reader() : to_read( new mq_block ) {}
+        mq_pool &pool;
+
+        mq_reader( mq_pool &p ) : to_read( p.make() ), pool( p ) { ++ pool._in_flight; }
+        ~mq_reader()
+        {
+            while ( to_read )
+                pool.put( std::exchange( to_read, to_read->next.load() ) );
+        }
 
         template< typename F >
         bool pop( F f )
         {
             if ( to_read->empty() && !to_read->next )
                 return false;
-            if ( to_read->empty() )
-                to_read = to_read->next;
+            if ( to_read->empty() ) /* no writer uses the block any more, see mq_sink */
+            {
+                auto done = std::exchange( to_read, to_read->next.load() );
+                -- pool._in_flight;
+                pool._queued -= done->ptr;
+                pool.put( done );
+            }
 
             ASSERT( !to_read->empty() );
             return to_read->pop< TL >( f );
@@ -132,12 +196,15 @@ namespace divine::mc
     struct mq_sink /* threads: multiple writers should be safe */
     {
         std::atomic< mq_block * > sent;
+        mq_pool &pool;
 
         template< typename TL >
-        mq_sink( mq_reader< TL > &r ) : sent( r.to_read ) {}
+        mq_sink( mq_reader< TL > &r ) : sent( r.to_read ), pool( r.pool ) {}
 
-        void append( mq_block *node )
+        void append( mq_block *node, int bytes )
         {
+            ++ pool._in_flight;
+            pool._queued += bytes;
             mq_block *last = sent.load();
             while ( !sent.compare_exchange_weak( last, node ) );
             last->next.store( node );
@@ -146,14 +213,29 @@ namespace divine::mc
 
     struct mq_buffer /* instance per sending thread */
     {
-        mq_block *open;
+        mq_block *open, *stash = nullptr;
         mq_sink &sink;
 
-        mq_buffer( mq_sink &sink ) : open( new mq_block ), sink( sink ) {}
+        mq_buffer( mq_sink &sink ) : sink( sink ) { open = get(); }
         ~mq_buffer()
         {
             flush( false );
-            delete open; /* in case an empty block was left behind the flush */
+            if ( open ) /* in case an empty block was left behind the flush */
+                sink.pool.put( open );
+            while ( stash )
+                sink.pool.put( std::exchange( stash, stash->next.load() ) );
+        }
+
+        mq_block *get()
+        {
+            if ( !stash )
+                stash = sink.pool.take();
+            if ( !stash )
+                return sink.pool.make();
+
+            auto b = std::exchange( stash, stash->next.load() );
+            b->reset();
+            return b;
         }
 
         bool flush( bool alloc = true )
@@ -161,26 +243,92 @@ namespace divine::mc
             if ( !open->ctr )
                 return false;
 
+            int bytes = open->ptr;
             open->ptr = open->ctr = 0;
-            sink.append( open );
+            sink.append( open, bytes );
 
             if ( alloc )
-                open = new mq_block;
+                open = get();
             else
                 open = nullptr;
             return true;
         }
     };
 
+    /* Used by the parallel weaver: each thread has a router, with a buffer
+     * for each of the receiving threads. Machine i lives in thread i % threads.
+     * Tasks for 'any' machine are sent to a specific one: the first which
+     * accepts the task (like in a sequential weaver), or another machine of
+     * the same type, in a round-robin fashion. */
+    struct mq_router
+    {
+        std::deque< mq_buffer > buffers;
+        const std::vector< std::vector< int > > *accept; /* task type → machines */
+        const std::vector< int > *kind; /* machine → first machine of the same type */
+        std::atomic< int64_t > *pending; /* tasks not yet processed */
+        unsigned _next = 0;
+
+        int pick( int tid, int from )
+        {
+            auto &acc = ( *accept )[ tid ];
+            auto same = [&]( int m, int first ) { return m != from && ( *kind )[ m ] == ( *kind )[ first ]; };
+            int first = -1, count = 0;
+
+            for ( int m : acc )
+                if ( m != from && first < 0 )
+                    first = m;
+            if ( first < 0 )
+                return -1; /* nobody takes the task */
+
+            for ( int m : acc )
+                count += same( m, first );
+
+            int n = _next++ % count;
+            for ( int m : acc )
+                if ( same( m, first ) && !n-- )
+                    return m;
+
+            UNREACHABLE( "no machine picked" );
+        }
+
+        template< typename T >
+        void put( mq_buffer &b, const T &t, int tid )
+        {
+            ++ *pending;
+            while ( !b.open->push( t, tid ) )
+                b.flush();
+        }
+
+        template< typename T >
+        void push( const T &t, int tid )
+        {
+            if ( t.msg_to == -2 )
+                for ( auto &b : buffers )
+                    put( b, t, tid );
+            else if ( t.msg_to >= 0 )
+                put( buffers[ t.msg_to % buffers.size() ], t, tid );
+            else if ( t.msg_to == -1 )
+            {
+                T copy = t;
+                copy.msg_to = pick( tid, t.msg_from );
+                if ( copy.msg_to >= 0 )
+                    put( buffers[ copy.msg_to % buffers.size() ], copy, tid );
+            }
+        }
+    };
+
     template< typename T >
     struct mq_writer
     {
         using type = T;
         mq_buffer *buffer;
+        mq_router *router = nullptr;
         int tid;
 
         void push( const T &t )
         {
+            if ( router )
+                return router->push( t, tid );
             while ( !buffer->open->push( t, tid ) )
                 buffer->flush();
         }
@@ -318,6 +466,8 @@ namespace divine::mc
         using task_types = typename TQ::template map_t< mq_type >;
 
         typename task_types::template map_t< mq_writer > _writers;
+        std::array< std::atomic< int64_t >, task_types::size > _delivered{};
+        mq_pool _pool;
         mq_reader< task_types > _reader;
         mq_sink _sink;
         mq_buffer _buffer;
@@ -363,37 +513,69 @@ namespace divine::mc
             _writers.each( [&]( auto &w ) { w.tid = i++; w.buffer = &_buffer; } );
         }
 
-        Weaver( MachineT mt ) : _machines( mt ), _sink( _reader ), _buffer( _sink ) { init_ids(); }
-        Weaver() : _sink( _reader ), _buffer( _sink ) { init_ids(); }
+        Weaver( MachineT mt )
+            : _machines( mt ), _reader( _pool ), _sink( _reader ), _buffer( _sink )
+        {
+            init_ids();
+        }
+
+        Weaver() : _reader( _pool ), _sink( _reader ), _buffer( _sink ) { init_ids(); }
+
+        /* how many times a task of the given type was taken by a machine */
+        template< typename T > int64_t delivered() const
+        {
+            return _delivered[ task_types::template index_of< T > ];
+        }
+
+        brick::mem::Stats mq_stats() const { return _pool.stats(); }
 
         template< typename T > T &machine()
         {
             return _machines.template get< T >();
         }
 
-        template< typename M, typename T >
-        auto run_on( M &m, T &t )
+        template< typename W, typename M, typename T >
+        auto run_on( W &w, M &m, T &t )
             -> decltype( m.run( std::declval< typename M::tq >(), t ), true )
         {
             m.prepare( t );
-            m.run( _writers.template view< typename M::tq >(), t );
+            m.run( w.template view< typename M::tq >(), t );
             return true;
         }
 
-        template< typename M, typename T >
-        auto run_on( M &m, T &t ) -> decltype( m.run( t ), true )
+        template< typename W, typename M, typename T >
+        auto run_on( W &, M &m, T &t ) -> decltype( m.run( t ), true )
         {
             m.run( t );
             return true;
         }
 
-        template< typename M >
-        auto run_on( M &, brq::fallback )
-            -> decltype( _writers.template view< typename M::tq >(), false )
+        template< typename W, typename M >
+        auto run_on( W &w, M &, brq::fallback )
+            -> decltype( w.template view< typename M::tq >(), false )
         {
             return false;
         }
 
+        /* whether run_on( m, t ) would accept the task, for routing */
+        template< typename M, typename T >
+        static constexpr auto accepts( int )
+            -> decltype( std::declval< M & >().run( std::declval< typename M::tq >(),
+                                                    std::declval< T & >() ), true )
+        {
+            return true;
+        }
+
+        template< typename M, typename T >
+        static constexpr auto accepts( long )
+            -> decltype( std::declval< M & >().run( std::declval< T & >() ), true )
+        {
+            return true;
+        }
+
+        template< typename M, typename T >
+        static constexpr bool accepts( ... ) { return false; }
+
         template< typename T, typename... Args >
         void add( Args... args )
         {
@@ -401,37 +583,157 @@ namespace divine::mc
             q.push( T( args... ) );
         }
 
-        void run() /* TODO parallel */
+        /* offer the task to those machines for which mine( index ) holds */
+        template< typename W, typename T, typename Mine >
+        void deliver( W &writers, T &t, Mine mine )
         {
-            auto process = [&]( auto t )
+            int i = 0;
+
+            auto one = [&]( auto &m )
             {
-                int i = 0;
+                TRACE( "trying machine", i, "to =", t.msg_to, "valid =", t.valid() );
+                if ( t.valid() && mine( i ) )
+                    if ( ( t.msg_to == i || t.msg_to < 0 ) && t.msg_from != i )
+                        if ( run_on( writers, m, t ) ) /* accepted */
+                        {
+                            TRACE( "task", t, "accepted by", &m );
+                            _delivered[ task_types::template index_of< T > ]
+                                .fetch_add( 1, std::memory_order_relaxed );
+                            if ( t.msg_to == -1 ) /* was targeted to anyone */
+                                t.msg_to = -3;
+                        }
+                i ++;
+            };
+
+            _machines.each( one );
+        }
 
-                auto one = [&]( auto &m )
+        void run()
+        {
+            auto process = [&]( auto t ) { deliver( _writers, t, []( int ) { return true; } ); };
+
+            while ( _buffer.flush() )
+                while ( _reader.pop( process ) );
+        }
+
+        struct Worker
+        {
+            mq_reader< task_types > reader;
+            mq_sink sink;
+            mq_router router;
+            typename task_types::template map_t< mq_writer > writers;
+            Worker( mq_pool &pool ) : reader( pool ), sink( reader ) {}
+        };
+
+        /* Each machine is only ever used by one of the threads (see
+         * mq_router), hence the machines need not be thread-safe, but the
+         * work is only spread if there are multiple machines of the same
+         * type, or if the pipeline has many stages. Observers run in the
+         * thread of their machine, too. */
+        void run( int threads )
+        {
+            if ( threads <= 1 )
+                return run();
+
+            std::vector< std::vector< int > > accept( task_types::size );
+            std::vector< int > kind;
+            std::atomic< int64_t > pending( 0 );
+            std::atomic< bool > failed( false );
+            std::deque< Worker > workers;
+            for ( int i = 0; i < threads; ++i )
+                workers.emplace_back( _pool );
+
+            _machines.each( [&]( auto &m )
+            {
+                int i = 0, idx = kind.size();
+                kind.push_back( idx );
+                _machines.each( [&]( auto &n )
                 {
-                    TRACE( "trying machine", i, "to =", t.msg_to, "valid =", t.valid() );
-                    if ( t.valid() )
-                        if ( ( t.msg_to == i || t.msg_to < 0 ) && t.msg_from != i )
-                            if ( run_on( m, t ) ) /* accepted */
-                            {
-                                TRACE( "task", t, "accepted by", &m );
-                                if ( t.msg_to == -1 ) /* was targeted to anyone */
-                                    t.msg_to = -3;
-                            }
-                    i ++;
+                    if ( std::is_same_v< decltype( m ), decltype( n ) > && i < kind[ idx ] )
+                        kind[ idx ] = i;
+                    ++ i;
+                } );
+                _writers.each( [&]( auto &w )
+                {
+                    using M = std::remove_reference_t< decltype( m ) >;
+                    if ( accepts< M, typename std::remove_reference_t< decltype( w ) >::type >( 0 ) )
+                        accept[ w.tid ].push_back( idx );
+                } );
+            } );
+
+            for ( auto &w : workers )
+            {
+                for ( auto &to : workers )
+                    w.router.buffers.emplace_back( to.sink );
+                w.router.accept = &accept;
+                w.router.kind = &kind;
+                w.router.pending = &pending;
+                w.writers = _writers;
+                w.writers.each( [&]( auto &wr ) { wr.router = &w.router; } );
+            }
+
+            /* hand over the tasks queued up by add() */
+            _buffer.flush();
+            while ( _reader.pop( [&]( auto t )
+                                 {
+                                     mq_writer< decltype( t ) > q = workers[ 0 ].writers;
+                                     q.push( t );
+                                 } ) );
+
+            auto work = [&]( int id )
+            {
+                auto &me = workers[ id ];
+                auto process = [&]( auto t )
+                {
+                    deliver( me.writers, t, [&]( int i ) { return i % threads == id; } );
+                    -- pending;
                 };
 
-                _machines.each( one );
+                try
+                {
+                    while ( pending && !failed )
+                    {
+                        bool busy = false;
+                        while ( me.reader.pop( process ) )
+                            busy = true;
+                        for ( auto &b : me.router.buffers )
+                            b.flush();
+                        if ( !busy )
+                            std::this_thread::yield();
+                    }
+                }
+                catch ( ... )
+                {
+                    failed = true;
+                    throw;
+                }
             };
 
-            while ( _buffer.flush() )
-                while ( _reader.pop( process ) );
+            /* The buffers of each router point into the sinks of all the
+             * workers, and a buffer flushes itself when destroyed. Hence all
+             * the threads must be joined and all the routers emptied before
+             * any of the workers goes away, even if a machine has thrown. */
+            std::vector< std::future< void > > running;
+            brick::types::Defer drain( [&]
+            {
+                failed = true;
+                for ( auto &r : running )
+                    if ( r.valid() )
+                        r.wait();
+                for ( auto &w : workers )
+                    w.router.buffers.clear();
+            } );
+
+            for ( int i = 0; i < threads; ++i )
+                running.emplace_back( std::async( std::launch::async, work, i ) );
+            for ( auto &r : running )
+                r.get();
         }
 
-        void start()
+        void start( int threads = 1 )
         {
             add< task::start >();
-            run();
+            run( threads );
         }
     };
 
@@ -106,6 +106,15 @@ struct Base
     template< typename S, typename F >
     void hash( Internal, int, S &, F ) const {}
 
+    /* Checkpoint images (see mc::image); each layer saves its own state and
+     * that of the layers below it. Slave pools are loaded before the pool
+     * they are attached to, i.e. _objects always comes last. */
+    template< typename Image >
+    void save( Image &img ) const { _objects.save( img ); }
+
+    template< typename Image >
+    void load( Image &img ) { _objects.load( img ); }
+
     static constexpr bool can_snapshot() { return false; }
 };
 
@@ -23,6 +23,9 @@
 #include <brick-hashset>
 #include <brick-mem>
 #include <unordered_set>
+#include <vector>
+#include <memory>
+#include <cstring>
 
 namespace divine::mem
 {
@@ -41,6 +44,18 @@ namespace divine::mem
 
         mutable brick::mem::RefPool< Pool, uint8_t, true > _obj_refcnt;
 
+        /* Deduplicated objects are immutable, hence their summaries (see
+         * Data::summary) are computed only once, by ObjHasher::hash right
+         * before the object enters the hash table, and stored here. */
+        struct Summary
+        {
+            hash64_t data;
+            int32_t pointers;
+            bool valid;
+        };
+
+        mutable brick::mem::SlavePool< Pool > _summary;
+
         struct ObjHasher : brq::hash_adaptor< Internal >
         {
             using HA = brq::hash_adaptor< Internal >;
@@ -51,7 +66,10 @@ namespace divine::mem
 
             hash64_t hash( Internal i ) const
             {
-                auto [ data, ptr ] = heap().hash_data( i );
+                int pointers;
+                auto [ data, ptr ] = heap().hash_data( i, &pointers );
+                heap()._summary.materialise( i, sizeof( Summary ), false );
+                *heap()._summary.template machinePointer< Summary >( i ) = { data, pointers, true };
                 return ( ptr & 0xFFFFFFFFul ) ^ data;
             }
 
@@ -65,18 +83,84 @@ namespace divine::mem
             typename HA::Erase erase( cell &c, const X &t, hash64_t ) const;
         };
 
+        /* Tree compression (see tree_compression() below). Instead of a flat
+         * array of SnapItems, a snapshot in the tree pool is a TreeRoot, which
+         * points to a binary tree of nodes. The nodes are hash-consed (in
+         * _ext.nodes), so that snapshots which only differ in a few objects
+         * share most of their nodes. A leaf holds a run of SnapItems; the
+         * leaf boundaries are derived from the object ids (and not from the
+         * positions of the items), hence an object which appears or vanishes
+         * only disturbs a single leaf. Like the tree tables in LTSmin, the
+         * nodes are never freed; each leaf holds a reference to each of its
+         * objects. */
+        struct TreeNode
+        {
+            uint32_t leaf:1, count:31; /* count is the number of items below */
+        };
+
+        struct TreeRoot
+        {
+            Snapshot top;
+            uint32_t count;
+        } __attribute__((packed));
+
+        static constexpr int tree_leaf_max = 32;
+        template< typename P > static P untagged( P p ) { return P( p.slab(), p.chunk() ); }
+        static bool tree_boundary( uint32_t objid ) { return ( objid * 0x9e3779b1u ) >> 29 == 0; }
+
+        struct NodeHasher : brq::hash_adaptor< Snapshot >
+        {
+            Pool *_pool;
+
+            hash64_t hash( Snapshot n ) const
+            {
+                return brq::hash( _pool->template machinePointer< uint8_t >( n ), _pool->size( n ) );
+            }
+
+            template< typename Cell >
+            typename Cell::pointer match( Cell &cell, Snapshot n, hash64_t hash ) const
+            {
+                if ( !cell.match( hash ) )
+                    return nullptr;
+                auto m = cell.fetch();
+                int size = _pool->size( m );
+                if ( _pool->size( n ) != size )
+                    return nullptr;
+                if ( std::memcmp( _pool->dereference( m ), _pool->dereference( n ), size ) )
+                    return nullptr;
+                return cell.value();
+            }
+        };
+
+        /* The flattened items of the current tree-compressed snapshot, which
+         * _l.snap_begin points into. The vector is shared by copies of the
+         * heap and replaced (not overwritten) when it is shared. */
+        struct Tree
+        {
+            std::shared_ptr< std::vector< SnapItem > > items;
+            std::vector< SnapItem > spare;
+            std::vector< Snapshot > level;
+        };
+
+        mutable Tree _tree;
+
         mutable struct Ext
         {
             ObjHasher hasher;
             brq::concurrent_hash_set< Internal > objects;
             Pool *_free_pool = nullptr;
             Snapshot _free_snap;
+            const void *tree = nullptr; /* the shared state of the tree pool */
+            NodeHasher nodehasher;
+            brq::concurrent_hash_set< Snapshot > nodes;
         } _ext;
 
         void setupHT() { _ext.hasher._heap = this; }
 
-        Cow() : _obj_refcnt( this->_objects ) { setupHT(); }
-        Cow( const Cow &o ) : Next( o ), _obj_refcnt( o._obj_refcnt ), _ext( o._ext )
+        Cow() : _obj_refcnt( this->_objects ), _summary( this->_objects ) { setupHT(); }
+        Cow( const Cow &o )
+            : Next( o ), _obj_refcnt( o._obj_refcnt ), _summary( o._summary ),
+              _tree( o._tree ), _ext( o._ext )
         {
             setupHT();
             ASSERT( _l.exceptions.empty() );
@@ -86,6 +170,8 @@ namespace divine::mem
         {
             Next::operator=( o );
             _obj_refcnt = o._obj_refcnt;
+            _summary = o._summary;
+            _tree = o._tree;
             _ext = o._ext;
             setupHT();
             ASSERT( _l.exceptions.empty() );
@@ -104,6 +190,55 @@ namespace divine::mem
         SnapItem snap_dedup( SnapItem si ) const;
         void snap_put( Pool &p, Snapshot s );
         void snap_put() const;
+        void obj_put( Internal i ) const;
+
+        template< typename Yield >
+        void snap_merge( Yield yield ) const;
+
+        Snapshot tree_snapshot( Pool &p ) const;
+        Snapshot tree_leaf( Pool &p, const SnapItem *items, int count ) const;
+        Snapshot tree_inner( Pool &p, Snapshot l, Snapshot r ) const;
+        Snapshot tree_dedup( Pool &p, Snapshot n ) const;
+        void tree_flatten( Pool &p, Snapshot n, std::vector< SnapItem > &out ) const;
+
+        /* Store the snapshots taken into (the pool which shares its state
+         * with) p as trees. Must be called before the first snapshot is taken
+         * and before the heap is copied; the tree pool cannot be saved. */
+        void tree_compression( Pool &p ) { _ext.tree = &*p._s; }
+        bool tree( Pool &p ) const { return _ext.tree == &*p._s; }
+
+        bool snap_equal( Pool &p, Snapshot a, Snapshot b ) const
+        {
+            if ( tree( p ) )
+            {
+                if ( !p.valid( a ) || !p.valid( b ) )
+                    return p.valid( a ) == p.valid( b );
+                auto ra = p.template machinePointer< TreeRoot >( a ),
+                     rb = p.template machinePointer< TreeRoot >( b );
+                return ra->count == rb->count && Snapshot( ra->top ) == Snapshot( rb->top );
+            }
+
+            return p.size( a ) == p.size( b ) &&
+                   std::equal( this->snap_begin( p, a ), this->snap_end( p, a ),
+                               this->snap_begin( p, b ) );
+        }
+
+        /* Objects which were not written since the last snapshot (or
+         * restore) are deduplicated, and their summary is already known. Any
+         * thread may get here (or to ObjHasher::hash, when the table grows);
+         * SlavePool::materialise installs each slab of _summary only once. */
+        std::pair< uint64_t, int > summary( Internal i, uint32_t objid ) const
+        {
+            if ( _l.exceptions.empty() || !_l.exceptions.count( objid ) )
+            {
+                _summary.materialise( i, sizeof( Summary ), false );
+                auto sum = _summary.template machinePointer< Summary >( i );
+                if ( sum->valid )
+                    return { sum->data, sum->pointers };
+            }
+
+            return Next::summary( i, objid );
+        }
 
         SnapItem *snap_get( SnapItem *si ) const
         {
@@ -111,17 +246,72 @@ namespace divine::mem
             return si;
         }
 
+        /* The deduplication table is not saved as such: load() inserts the
+         * saved objects into an empty table (their hashes are recomputed),
+         * which is only possible once all the layers are loaded. */
+        template< typename Image >
+        void save( Image &img ) const
+        {
+            ASSERT( !_ext.tree ); /* the node table is not saved */
+            _obj_refcnt.save( img );
+            _summary.save( img );
+
+            auto &objs = _ext.objects;
+            std::vector< Internal > live;
+            for ( size_t i = 0; i < objs.capacity(); ++i )
+                if ( objs.valid( i ) && !objs.cell_at( i ).tombstone() )
+                    live.push_back( objs.valueAt( i ) );
+            img.put( uint64_t( live.size() ) );
+            for ( auto obj : live )
+                img.put( obj );
+
+            Next::save( img );
+        }
+
+        template< typename Image >
+        void load( Image &img )
+        {
+            _ext._free_pool = nullptr; /* refers to the old content of the pool */
+            _obj_refcnt.load( img );
+            _summary.load( img );
+
+            std::vector< Internal > live( img.template get< uint64_t >() );
+            for ( auto &obj : live )
+                obj = img.template get< Internal >();
+
+            Next::load( img );
+
+            _ext.objects = decltype( _ext.objects )();
+            for ( auto obj : live )
+                _ext.objects.insert( obj, _ext.hasher );
+        }
+
         bool is_shared( Pool &p, Snapshot s ) const
         {
+            if ( tree( p ) )
+                return false; /* the items are flattened into _tree.items */
             return p.template machinePointer< SnapItem >( s ) == _l.snap_begin;
         }
 
         void restore( Pool &p, Snapshot s )
         {
             snap_put();
+            _l.exceptions.clear();
+
+            if ( tree( p ) )
+            {
+                if ( !_tree.items || _tree.items.use_count() > 1 )
+                    _tree.items = std::make_shared< std::vector< SnapItem > >();
+                _tree.items->clear();
+                if ( p.valid( s ) )
+                    tree_flatten( p, p.template machinePointer< TreeRoot >( s )->top, *_tree.items );
+                _l.snap_size = _tree.items->size();
+                _l.snap_begin = _tree.items->data();
+                return;
+            }
+
             _l.snap_size = p.size( s ) / sizeof( SnapItem );
             _l.snap_begin = p.template machinePointer< SnapItem >( s );
-            _l.exceptions.clear();
         }
 
         static constexpr bool can_snapshot() { return true; }
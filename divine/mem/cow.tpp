@@ -117,6 +117,16 @@ namespace divine::mem
         auto s = _ext._free_snap;
         _ext._free_pool = nullptr;
 
+        if ( !tree( p ) ) /* tree nodes are never released */
+            for ( auto si = this->snap_begin( p, s ); si != this->snap_end( p, s ); ++si )
+                obj_put( si->second );
+
+        p.free( s );
+    }
+
+    template< typename Next >
+    void Cow< Next >::obj_put( Internal i ) const
+    {
         auto erase = [&]( auto x, int refcnt )
         {
             if ( refcnt == 1 )
@@ -124,50 +134,172 @@ namespace divine::mem
             return true;
         };
 
-        for ( auto si = this->snap_begin( p, s ); si != this->snap_end( p, s ); ++si )
-            _obj_refcnt.put( si->second, erase );
-
-        p.free( s );
+        _obj_refcnt.put( i, erase );
     }
 
-    template< typename Next >
-    auto Cow< Next >::snapshot( Pool &p ) const -> Snapshot
+    /* Yield the items of the new snapshot, i.e. the current one with the
+     * exceptions merged in. Each yielded item holds a reference. */
+    template< typename Next > template< typename Yield >
+    void Cow< Next >::snap_merge( Yield yield ) const
     {
-        int count = 0;
         auto snap = this->snap_begin();
 
         for ( auto &except : _l.exceptions )
         {
             while ( snap != this->snap_end() && snap->first < except.first )
-                ++ snap, ++ count;
+                yield( *snap_get( snap++ ) );
             if ( snap != this->snap_end() && snap->first == except.first )
                 snap++;
             if ( this->valid( except.second ) )
-                ++ count;
+                yield( snap_dedup( except ) );
         }
 
         while ( snap != this->snap_end() )
-            ++ snap, ++ count;
+            yield( *snap_get( snap++ ) );
+    }
 
-        if ( !count )
+    template< typename Next >
+    auto Cow< Next >::tree_dedup( Pool &p, Snapshot n ) const -> Snapshot
+    {
+        _ext.nodehasher._pool = &p;
+        Snapshot r = *_ext.nodes.insert( n, _ext.nodehasher );
+        if ( r == n )
+            return n;
+        p.free( n );
+        return r;
+    }
+
+    template< typename Next >
+    auto Cow< Next >::tree_leaf( Pool &p, const SnapItem *items, int count ) const -> Snapshot
+    {
+        auto n = p.allocate( sizeof( TreeNode ) + count * sizeof( SnapItem ) );
+        auto node = p.template machinePointer< TreeNode >( n );
+        std::memset( node, 0, p.size( n ) );
+        node->leaf = 1;
+        node->count = count;
+
+        auto si = reinterpret_cast< SnapItem * >( node + 1 );
+        for ( int i = 0; i < count; ++i )
+            si[ i ].first = items[ i ].first, si[ i ].second = untagged( items[ i ].second );
+
+        auto r = tree_dedup( p, n );
+        if ( r != n ) /* the existing leaf holds its own references */
+            for ( int i = 0; i < count; ++i )
+                obj_put( items[ i ].second );
+        return r;
+    }
+
+    template< typename Next >
+    auto Cow< Next >::tree_inner( Pool &p, Snapshot l, Snapshot r ) const -> Snapshot
+    {
+        auto n = p.allocate( sizeof( TreeNode ) + 2 * sizeof( Snapshot ) );
+        auto node = p.template machinePointer< TreeNode >( n );
+        std::memset( node, 0, p.size( n ) );
+        node->count = p.template machinePointer< TreeNode >( l )->count +
+                      p.template machinePointer< TreeNode >( r )->count;
+
+        auto child = reinterpret_cast< Snapshot * >( node + 1 );
+        child[ 0 ] = untagged( l );
+        child[ 1 ] = untagged( r );
+        return tree_dedup( p, n );
+    }
+
+    template< typename Next >
+    void Cow< Next >::tree_flatten( Pool &p, Snapshot n, std::vector< SnapItem > &out ) const
+    {
+        auto node = p.template machinePointer< TreeNode >( n );
+        if ( node->leaf )
+        {
+            auto si = reinterpret_cast< SnapItem * >( node + 1 );
+            out.insert( out.end(), si, si + node->count );
+        }
+        else
+        {
+            auto child = reinterpret_cast< Snapshot * >( node + 1 );
+            tree_flatten( p, child[ 0 ], out );
+            tree_flatten( p, child[ 1 ], out );
+        }
+    }
+
+    /* The leaves are built first, then adjacent nodes are paired up, level by
+     * level, until a single node remains. */
+    template< typename Next >
+    auto Cow< Next >::tree_snapshot( Pool &p ) const -> Snapshot
+    {
+        auto &items = _tree.spare;
+        items.clear();
+        snap_merge( [&]( SnapItem si ) { items.push_back( si ); } );
+
+        if ( items.empty() )
             return Snapshot();
 
-        auto s = p.allocate( count * sizeof( SnapItem ) );
-        auto si = p.template machinePointer< SnapItem >( s );
-        snap = this->snap_begin();
+        auto &level = _tree.level;
+        level.clear();
+
+        for ( int i = 0, start = 0; i < int( items.size() ); ++i )
+            if ( i + 1 == int( items.size() ) || i + 1 - start == tree_leaf_max ||
+                 tree_boundary( items[ i ].first ) )
+            {
+                level.push_back( tree_leaf( p, &items[ start ], i + 1 - start ) );
+                start = i + 1;
+            }
+
+        while ( level.size() > 1 )
+        {
+            size_t j = 0;
+            for ( size_t i = 0; i + 1 < level.size(); i += 2 )
+                level[ j++ ] = tree_inner( p, level[ i ], level[ i + 1 ] );
+            if ( level.size() % 2 )
+                level[ j++ ] = level.back();
+            level.resize( j );
+        }
+
+        auto s = p.allocate( sizeof( TreeRoot ) );
+        auto root = p.template machinePointer< TreeRoot >( s );
+        root->top = level[ 0 ];
+        root->count = items.size();
+
+        snap_put();
+        _l.exceptions.clear();
+        if ( !_tree.items || _tree.items.use_count() > 1 )
+            _tree.items = std::make_shared< std::vector< SnapItem > >();
+        _tree.items->swap( items );
+        _l.snap_begin = _tree.items->data();
+        _l.snap_size = _tree.items->size();
+
+        Next::notify_snapshot();
+
+        return s;
+    }
+
+    template< typename Next >
+    auto Cow< Next >::snapshot( Pool &p ) const -> Snapshot
+    {
+        if ( tree( p ) )
+            return tree_snapshot( p );
+
+        int count = 0;
+        auto snap = this->snap_begin();
 
         for ( auto &except : _l.exceptions )
         {
             while ( snap != this->snap_end() && snap->first < except.first )
-                *si++ = *snap_get( snap++ );
+                ++ snap, ++ count;
             if ( snap != this->snap_end() && snap->first == except.first )
                 snap++;
             if ( this->valid( except.second ) )
-                *si++ = snap_dedup( except );
+                ++ count;
         }
 
         while ( snap != this->snap_end() )
-            *si++ = *snap_get( snap++ );
+            ++ snap, ++ count;
+
+        if ( !count )
+            return Snapshot();
+
+        auto s = p.allocate( count * sizeof( SnapItem ) );
+        auto si = p.template machinePointer< SnapItem >( s );
+        snap_merge( [&]( SnapItem item ) { *si++ = item; } );
 
         auto newsnap = p.template machinePointer< SnapItem >( s );
         ASSERT_EQ( si, newsnap + count );
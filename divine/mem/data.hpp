@@ -60,15 +60,28 @@ namespace divine::mem
             int snap_size = 0;
         } _l;
 
-        std::pair< uint64_t, uint64_t > hash_data( Internal i ) const
+        std::pair< uint64_t, uint64_t > hash_data( Internal i, int *pointers = nullptr ) const
         {
             brq::hash_state data, ptr;
-            auto ptr_cb = [&]( uint32_t obj ) { ptr.update_aligned( obj ); };
+            int count = 0;
+            auto ptr_cb = [&]( uint32_t obj ) { ptr.update_aligned( obj ); ++ count; };
             hash( i, size( i ), data, ptr_cb );
             TRACE( "hash_data", std::hex, data.hash(), ptr.hash() );
+            if ( pointers )
+                *pointers = count;
             return { data.hash(), ptr.hash() };
         }
 
+        /* The content hash of an object (which does not depend on the
+         * pointers it holds) and the number of pointers in the object. This
+         * is what mem::hash needs to know about each reachable object. */
+        std::pair< uint64_t, int > summary( Internal i, uint32_t ) const
+        {
+            int count = 0;
+            auto data = hash_data( i, &count ).first;
+            return { data, count };
+        }
+
         Internal detach( Loc l ) { return l.object; }
 
         template< typename S, typename F >
@@ -80,6 +93,10 @@ namespace divine::mem
         void reset() { _l.exceptions.clear(); _l.snap_size = 0; _l.snap_begin = nullptr; }
         void rollback() { _l.exceptions.clear(); } /* fixme leak */
 
+        /* the current (unsaved) state of the heap is discarded by load() */
+        template< typename Image >
+        void load( Image &img ) { reset(); Next::load( img ); }
+
         using Next::loc;
         Loc loc( Pointer p ) const { return loc( p, ptr2i( p ) ); }
 
@@ -192,6 +192,20 @@ struct DefinednessLayer : public NextLayer
         NextLayer::free( p );
     }
 
+    template< typename Image >
+    void save( Image &img ) const
+    {
+        _def_exceptions->save( img );
+        NextLayer::save( img );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        _def_exceptions->load( img );
+        NextLayer::load( img );
+    }
+
     template< typename V >
     void write( Loc l, V value, Expanded *exp )
     {
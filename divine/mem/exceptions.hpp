@@ -70,6 +70,20 @@ struct SlavePoolSnapshotter
     {
         _snap_pointers.materialise( obj, sizeof( SnapPointer ) );
     }
+
+    template< typename Image >
+    void save( Image &img ) const
+    {
+        _snap_pointers.save( img );
+        _snapshots.save( img );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        _snap_pointers.load( img );
+        _snapshots.load( img );
+    }
 };
 
 template< typename Internal, typename K, typename V,
@@ -165,6 +179,21 @@ struct SnapshottedMap : SnapshotterT< typename std::map<K, V>::value_type, SnapO
         ASSERT( !snapped( obj ) );
     }
 
+    /* only snapshotted data is saved, see snapshot() */
+    template< typename Image >
+    void save( Image &img ) const
+    {
+        ASSERT( _l._maps.empty() );
+        Snapshotter::save( img );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        _l._maps.clear();
+        Snapshotter::load( img );
+    }
+
     void free( Internal obj )
     {
         ASSERT( !snapped( obj ) );
@@ -648,6 +677,27 @@ struct ExceptionMap
                             []( const auto & e ) { return ! e.second.valid(); } );
     }
 
+    template< typename Image >
+    void save( Image &img )
+    {
+        Lock lk( _mtx );
+        img.put( uint64_t( _exceptions.size() ) );
+        for ( const auto &[ loc, exc ] : _exceptions )
+            img.put( loc ), img.put( exc );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        Lock lk( _mtx );
+        _exceptions.clear();
+        for ( auto count = img.template get< uint64_t >(); count; --count )
+        {
+            auto loc = img.template get< Loc >();
+            _exceptions.emplace_hint( _exceptions.end(), loc, img.template get< ExceptionType >() );
+        }
+    }
+
     ExcMap _exceptions;
     mutable std::mutex _mtx;
 };
@@ -100,6 +100,7 @@ namespace divine::mem
         bool valid( Pointer p ) const  { return n.valid( p ); }
         bool valid( Internal i ) const { return n.valid( i ); }
         auto hash_data( Internal i ) const { return n.hash_data( i ); }
+        auto summary( uint32_t obj, Internal i ) const { return n.summary( i, obj ); }
 
         template< typename S, typename F >
         void hash( uint32_t obj, S &state, F ptr_cb ) const
@@ -119,8 +120,11 @@ namespace divine::mem
         Snapshot snapshot( Pool &p ) { return n.snapshot( p ); }
         void restore( Pool &p, Snapshot s ) { n.restore( p, s ); }
         bool is_shared( Pool &p, Snapshot s ) const { return n.is_shared( p, s ); }
+        bool snap_equal( Pool &p, Snapshot a, Snapshot b ) const { return n.snap_equal( p, a, b ); }
+        void tree_compression( Pool &p ) { n.tree_compression( p ); }
         void reset() { n.reset(); }
         void snap_put( Pool &p, Snapshot s ) { n.snap_put( p, s ); }
+        void snap_put() const { n.snap_put(); }
 
         auto snap_begin() const { return n.snap_begin(); }
         auto snap_end() const { return n.snap_end(); }
@@ -241,6 +241,12 @@ struct Metadata : Next
     auto &meta() { return _meta; }
     void materialise( Internal i, int size ) { _meta.materialise( i, meta_size( size ) ); }
 
+    template< typename Image >
+    void save( Image &img ) const { _meta.save( img ); Next::save( img ); }
+
+    template< typename Image >
+    void load( Image &img ) { _meta.load( img ); Next::load( img ); }
+
     static constexpr int meta_size( int size )
     {
         constexpr unsigned divisor = 32 / BPW;
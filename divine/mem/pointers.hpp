@@ -193,6 +193,20 @@ struct PointerLayer : public NextLayer
         NextLayer::free( p );
     }
 
+    template< typename Image >
+    void save( Image &img ) const
+    {
+        _ptr_exceptions->save( img );
+        NextLayer::save( img );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        _ptr_exceptions->load( img );
+        NextLayer::load( img );
+    }
+
     template< typename V >
     void write( Loc l, V value, Expanded *exp )
     {
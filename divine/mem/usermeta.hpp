@@ -87,6 +87,24 @@ struct UserMeta : Next
         Next::free( p );
     }
 
+    template< typename Image >
+    void save( Image &img ) const
+    {
+        for ( auto t : layer_types() )
+            img.put( t );
+        _maps._storage.save( img );
+        Next::save( img );
+    }
+
+    template< typename Image >
+    void load( Image &img )
+    {
+        for ( int i = 0; i < NLayers; ++i )
+            layer_type( i, img.template get< MetaType >() );
+        _maps._storage.load( img );
+        Next::load( img );
+    }
+
     std::tuple< int, int, Value > peek( Loc l, int len, int layer )
     {
         if ( auto *p = _maps.intersect( l.object, { l.offset, layer }, len ) )
@@ -20,7 +20,7 @@
 
 #include <divine/vm/types.hpp>
 #include <divine/vm/pointer.hpp>
-#include <unordered_map>
+#include <vector>
 
 namespace divine::mem
 {
@@ -35,23 +35,101 @@ namespace divine::mem
         void structure( Pointer, Pointer, int, int ) {}
     };
 
+    /* A map from object ids to small integers, used as the visited set of
+     * the heap traversals below. Each slot is tagged with the epoch in which
+     * it was written, so that clearing the map is O(1): a single instance
+     * can be reused for any number of traversals, which then do not need to
+     * allocate any memory (except when the map needs to grow). */
+    struct Visited
+    {
+        struct Slot { uint32_t epoch, key; int value; };
+
+        std::vector< Slot > _slots;
+        uint32_t _epoch = 1;
+        int _used = 0, _bits = 0;
+
+        Visited() { _slots.resize( 64 ); _bits = 6; }
+
+        size_t mask() const { return _slots.size() - 1; }
+        size_t index( uint32_t key ) const
+        {
+            return ( key * 0x9e3779b97f4a7c15ull ) >> ( 64 - _bits );
+        }
+
+        void clear()
+        {
+            _used = 0;
+            if ( ++ _epoch )
+                return;
+            for ( auto &s : _slots ) /* the epoch counter wrapped around */
+                s.epoch = 0;
+            _epoch = 1;
+        }
+
+        int *find( uint32_t key )
+        {
+            for ( size_t i = index( key ); ; i = ( i + 1 ) & mask() )
+            {
+                auto &s = _slots[ i ];
+                if ( s.epoch != _epoch )
+                    return nullptr;
+                if ( s.key == key )
+                    return &s.value;
+            }
+        }
+
+        /* the key must not be present in the map */
+        void insert( uint32_t key, int value )
+        {
+            if ( 2 * ( _used + 1 ) > int( _slots.size() ) )
+                grow();
+
+            for ( size_t i = index( key ); ; i = ( i + 1 ) & mask() )
+                if ( _slots[ i ].epoch != _epoch )
+                {
+                    _slots[ i ] = Slot{ _epoch, key, value };
+                    ++ _used;
+                    return;
+                }
+        }
+
+        void grow()
+        {
+            std::vector< Slot > old( 2 * _slots.size() );
+            old.swap( _slots );
+            ++ _bits;
+            _used = 0;
+
+            for ( auto &s : old )
+                if ( s.epoch == _epoch )
+                    insert( s.key, s.value );
+        }
+    };
+
     template< typename H1, typename H2, typename CB >
     int compare( H1 &h1, H2 &h2, typename H1::Pointer r1, typename H1::Pointer r2,
-                std::unordered_map< int, int > &v1, std::unordered_map< int, int > &v2, int &seq,
-                CB &callback );
+                 Visited &v1, Visited &v2, int &seq, CB &callback );
 
     template< typename Heap >
-    void hash( Heap &heap, uint32_t root, std::unordered_map< int, int > &visited,
-               brq::hash_state &state, int depth );
+    void hash( Heap &heap, uint32_t root, Visited &visited, brq::hash_state &state, int depth );
 
     template< typename H1, typename H2, typename CB >
-    int compare( H1 &h1, H2 &h2, typename H1::Pointer r1, typename H1::Pointer r2, CB &callback )
+    int compare( H1 &h1, H2 &h2, typename H1::Pointer r1, typename H1::Pointer r2,
+                 Visited &v1, Visited &v2, CB &callback )
     {
-        std::unordered_map< int, int > v1, v2;
+        v1.clear();
+        v2.clear();
         int seq = 1;
         return compare( h1, h2, r1, r2, v1, v2, seq, callback );
     }
 
+    template< typename H1, typename H2, typename CB >
+    int compare( H1 &h1, H2 &h2, typename H1::Pointer r1, typename H1::Pointer r2, CB &callback )
+    {
+        Visited v1, v2;
+        return compare( h1, h2, r1, r2, v1, v2, callback );
+    }
+
     template< typename H1, typename H2 >
     int compare( H1 &h1, H2 &h2, typename H1::Pointer r1, typename H1::Pointer r2 )
     {
@@ -60,14 +138,21 @@ namespace divine::mem
     }
 
     template< typename Heap >
-    hash64_t hash( Heap &heap, typename Heap::Pointer root )
+    hash64_t hash( Heap &heap, typename Heap::Pointer root, Visited &visited )
     {
-        std::unordered_map< int, int > visited;
         brq::hash_state state( 0 );
+        visited.clear();
         hash( heap, root.object(), visited, state, 0 );
         return state.hash();
     }
 
+    template< typename Heap >
+    hash64_t hash( Heap &heap, typename Heap::Pointer root )
+    {
+        Visited visited;
+        return hash( heap, root, visited );
+    }
+
     enum class CloneType { All, SkipWeak, HeapOnly };
 
     template< typename FromH, typename ToH >
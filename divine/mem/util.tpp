@@ -26,8 +26,7 @@ namespace divine::mem
 
     template< typename H1, typename H2, typename CB >
     int compare( H1 &h1, H2 &h2, typename H1::Pointer r1, typename H1::Pointer r2,
-                 std::unordered_map< int, int > &v1,
-                 std::unordered_map< int, int > &v2, int &seq, CB &cb )
+                 Visited &v1, Visited &v2, int &seq, CB &cb )
     {
         using Pointer = typename H1::Pointer;
 
@@ -36,21 +35,21 @@ namespace divine::mem
         auto v1r1 = v1.find( r1.object() );
         auto v2r2 = v2.find( r2.object() );
 
-        if ( v1r1 != v1.end() && v2r2 != v2.end() )
+        if ( v1r1 && v2r2 )
         {
-            auto d = v1r1->second - v2r2->second;
+            auto d = *v1r1 - *v2r2;
             if ( d )
-                cb.structure( r1, r2, v1r1->second, v2r2->second );
+                cb.structure( r1, r2, *v1r1, *v2r2 );
             return d;
         }
 
-        if ( v1r1 != v1.end() )
-            return cb.structure( r1, r2, v1r1->second, 0 ), -1;
-        if ( v2r2 != v2.end() )
-            return cb.structure( r1, r2, 0, v2r2->second ), 1;
+        if ( v1r1 )
+            return cb.structure( r1, r2, *v1r1, 0 ), -1;
+        if ( v2r2 )
+            return cb.structure( r1, r2, 0, *v2r2 ), 1;
 
-        v1[ r1.object() ] = seq;
-        v2[ r2.object() ] = seq;
+        v1.insert( r1.object(), seq );
+        v2.insert( r2.object(), seq );
         ++ seq;
 
         if ( int d = h1.valid( r1 ) - h2.valid( r2 ) )
@@ -100,12 +99,11 @@ namespace divine::mem
     };
 
     template< typename Heap >
-    void hash( Heap &heap, uint32_t root, std::unordered_map< int, int > &visited,
-               brq::hash_state &state, int depth )
+    void hash( Heap &heap, uint32_t root, Visited &visited, brq::hash_state &state, int depth )
     {
-        if ( auto seen = visited.find( root ); seen != visited.end() )
+        if ( auto seen = visited.find( root ) )
         {
-            state.update_aligned( seen->second );
+            state.update_aligned( *seen );
             return;
         }
 
@@ -113,14 +111,16 @@ namespace divine::mem
         if ( !heap.valid( i ) )
             return;
 
-        int size = heap.size( i );
-        uint32_t content_hash = i.tag();
+        /* the content hash is usually cached (see Cow::summary), so that
+         * only the pointers need to be visited */
+        auto [ data, pointers ] = heap.summary( root, i );
+        uint32_t content_hash = data;
 
-        visited.emplace( root, content_hash );
+        visited.insert( root, content_hash );
         state.update_aligned( content_hash );
 
-        if ( size > 64 * 1024 )
-            return; /* skip the huge constants blobs */
+        if ( !pointers || heap.size( i ) > 64 * 1024 )
+            return; /* nothing to follow, or one of the huge constants blobs */
 
         auto ptr_cb = [&]( uint32_t obj )
         {
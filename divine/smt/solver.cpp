@@ -4,6 +4,12 @@
 #include <brick-proc>
 #include <brick-bitlevel>
 
+#include <condition_variable>
+#include <functional>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
 using namespace divine::smt::builder;
 
 namespace divine::smt::solver
@@ -20,18 +26,62 @@ Result SMTLib::solve()
     for ( auto clause : _asserts )
         q = builder::mk_bin( b, brq::smt_op::bv_and, 1, q, clause );
 
-    auto r = brick::proc::spawnAndWait( proc::StdinString( _ctx.query( q ) ) | proc::CaptureStdout |
-                                        proc::CaptureStderr, _opts );
+    if ( !_proc )
+    {
+        _proc.reset( new proc::Coprocess( _opts ) );
+        _declared.clear();
+    }
+
+    brq::string_builder cmd;
+    for ( auto &[ name, sort ] : _ctx.vars )
+    {
+        std::string str = brq::format( sort ).buffer();
+        auto decl = _declared.find( name );
+
+        if ( decl != _declared.end() && decl->second == str )
+            continue;
+
+        if ( decl != _declared.end() ) /* a name with a different sort: start over */
+        {
+            _declared.clear();
+            cmd.clear();
+            cmd << "(reset)\n";
+            for ( auto &[ n, s ] : _ctx.vars )
+            {
+                _declared.emplace( n, brq::format( s ).buffer() );
+                cmd << "(declare-fun " << n << " () " << s << ")\n";
+            }
+            break;
+        }
+
+        _declared.emplace( name, str );
+        cmd << "(declare-fun " << name << " () " << sort << ")\n";
+    }
+
+    cmd << "(push 1)\n(assert ";
+    _ctx.print( cmd, q, false );
+    cmd << ")\n(check-sat)\n(pop 1)\n";
 
-    std::string_view result = r.out();
-    if ( result.substr( 0, 5 ) == "unsat" )
+    if ( cmd.truncated() )
+        throw std::bad_alloc();
+
+    std::string result;
+    bool ok = false;
+
+    try
+    {
+        _proc->write( cmd.data() );
+        ok = _proc->read_line( result );
+    } catch ( proc::ProcError & ) {}
+
+    if ( ok && result.substr( 0, 5 ) == "unsat" )
         return Result::False;
-    if ( result.substr( 0, 3 ) == "sat" )
+    if ( ok && result.substr( 0, 3 ) == "sat" )
         return Result::True;
-    if ( result.substr( 0, 7 ) == "unknown" )
+    if ( ok && result.substr( 0, 7 ) == "unknown" )
         return Result::Unknown;
 
-    std::cerr << "E: The SMT solver produced an error: " << r.out() << std::endl
+    std::cerr << "E: The SMT solver produced an error: " << result << std::endl
               << "E: The input formula was: " << std::endl
               << _ctx.query( q ) << std::endl;
     UNREACHABLE( "Invalid SMT reply" );
@@ -47,27 +97,48 @@ op_t equality( const Node& node ) noexcept
 }
 
 template< typename Core >
-bool Simple< Core >::equal( vm::HeapPointer path, SymPairs &sym_pairs,
-                            vm::CowHeap &h_1, vm::CowHeap &h_2 )
+EqualQuery Simple< Core >::read_query( vm::HeapPointer path, SymPairs &sym_pairs,
+                                      vm::CowHeap &h_1, vm::CowHeap &h_2 )
 {
-    equality_timer _t;
-    this->reset();
     auto e_1 = this->extract( h_1, 1 ), e_2 = this->extract( h_2, 2 );
+    EqualQuery q;
+
+    q.c_1 = e_1.read_constraints( path );
+    q.c_2 = e_2.read_constraints( path );
+
+    for ( auto [lhs, rhs] : sym_pairs )
+        q.pairs.emplace_back( e_1.read( lhs ), e_2.read( rhs ) );
+
+    return q;
+}
+
+template< typename Core >
+FeasibleQuery Simple< Core >::read_query( vm::CowHeap &heap, const Assumes &as )
+{
+    auto e = this->extract( heap, 1 );
+    FeasibleQuery q;
+
+    for ( auto a : as )
+        q.push_back( e.read( a ) );
+
+    return q;
+}
+
+template< typename Core >
+Result Simple< Core >::check( const EqualQuery &q )
+{
+    this->reset();
+    auto b_1 = this->builder( 1 ), b_2 = this->builder( 2 );
     auto b = this->builder();
 
     auto v_eq = b.constant( true );
-    auto c_1_rpn = e_1.read_constraints( path ),
-         c_2_rpn = e_2.read_constraints( path );
-    auto c_1 = c_1_rpn.empty() ? b.constant( true ) : evaluate( e_1, c_1_rpn ),
-         c_2 = c_2_rpn.empty() ? b.constant( true ) : evaluate( e_2, c_2_rpn );
+    auto c_1 = q.c_1.empty() ? b.constant( true ) : evaluate( b_1, q.c_1 ),
+         c_2 = q.c_2.empty() ? b.constant( true ) : evaluate( b_2, q.c_2 );
 
-    for ( auto [lhs, rhs] : sym_pairs )
+    for ( auto &[ f_1, f_2 ] : q.pairs )
     {
-        auto f_1 = e_1.read( lhs );
-        auto f_2 = e_2.read( rhs );
-
-        auto v_1 = evaluate( e_1, f_1 );
-        auto v_2 = evaluate( e_2, f_2 );
+        auto v_1 = evaluate( b_1, f_1 );
+        auto v_2 = evaluate( b_2, f_2 );
 
         brq::smt_op op = equality< Core >( v_1 );
         auto pair_eq = mk_bin( b, op, 1, v_1, v_2 );
@@ -80,86 +151,309 @@ bool Simple< Core >::equal( vm::HeapPointer path, SymPairs &sym_pairs,
        v_eq_c = mk_bin( b, op_t::bool_or, 1, pc_fail, v_eq ),
            eq = mk_bin( b, op_t::bool_and, 1, c_eq, v_eq_c );
 
+    /* covered: wherever c_2 holds, so does c_1 and the values are the same */
+    if ( q.subsume )
+        eq = mk_bin( b, op_t::bool_or, 1, mk_un( b, op_t::bool_not, 1, c_2 ),
+                     mk_bin( b, op_t::bool_and, 1, c_1, v_eq ) );
+
     this->add( mk_un( b, op_t::bool_not, 1, eq ) );
     auto r = this->solve();
     this->reset();
-    return r == Result::False;
+    return r;
 }
 
 template< typename Core >
-bool Simple< Core >::feasible( vm::CowHeap & heap, vm::HeapPointer ptr )
+Result Simple< Core >::check( const FeasibleQuery &q )
 {
-    feasibility_timer _t;
     this->reset();
-    auto e = this->extract( heap, 1 );
     auto b = this->builder();
-    auto query = evaluate( e, e.read( ptr ) );
-    this->add( mk_bin( b, op_t::eq, 1, query, b.constant( 1, 1 ) ) );
-    return this->solve() != Result::False;
+
+    for ( auto &expr : q )
+    {
+        auto query = evaluate( b, expr );
+        this->add( mk_bin( b, op_t::eq, 1, query, b.constant( 1, 1 ) ) );
+    }
+
+    return this->solve();
 }
 
-template< typename Core >
-bool Caching< Core >::feasible( vm::CowHeap &heap, vm::HeapPointer ptr )
+void QueryKey::add( expr_t e )
 {
-    feasibility_timer _t;
-    auto extract = this->extract( heap, 1 );
-    auto expr = extract.read( ptr );
+    for ( auto &atom : e )
+        if ( auto id = atom.varid() )
+        {
+            auto name = _names.emplace( id, _names.size() + 1 ).first;
+            atom.imm_set( name->second );
+        }
+
+    uint32_t size = e.base::size();
+    _bytes.append( reinterpret_cast< const char * >( &size ), sizeof( size ) );
+    _bytes.append( e.base::begin(), e.base::end() );
+}
 
-    if ( auto hit = _cache.find( item{ expr, 0, 0 } ); hit.valid() )
-        return ++ hit->hits, hit->sat;
+std::optional< bool > QueryCache::find( const QueryKey &k )
+{
+    if ( auto hit = _set.find( item{ k._bytes, false } ); hit.valid() )
+        return ++ _hits, hit->sat;
+    ++ _misses;
+    return std::nullopt;
+}
 
-    this->reset();
-    auto b = this->builder();
-    auto query = evaluate( extract, expr );
-    this->add( mk_bin( b, op_t::eq, 1, query, b.constant( 1, 1 ) ) );
-    bool rv = this->solve() != Result::False;
-    _cache.insert( item{ expr, 0, rv } );
-    return rv;
+void QueryCache::insert( const QueryKey &k, Result r )
+{
+    if ( r == Result::Unknown ) /* a different solver (or version) may do better */
+        return;
+
+    bool sat = r == Result::True;
+    if ( !_set.insert( item{ k._bytes, sat } ).isnew() || _fd < 0 )
+        return;
+
+    /* record: key size, key, result */
+    std::string rec;
+    uint32_t size = k._bytes.size();
+    rec.append( reinterpret_cast< const char * >( &size ), sizeof( size ) );
+    rec.append( k._bytes );
+    rec += char( sat );
+
+    std::lock_guard< std::mutex > _lock( _mutex );
+    if ( ::write( _fd, rec.data(), rec.size() ) != ssize_t( rec.size() ) )
+        brq::raise< brq::system_error >() << "writing the solver cache";
 }
 
-template< typename Core >
-bool Incremental< Core >::feasible( vm::CowHeap &/*heap*/, vm::HeapPointer /*ptr*/ )
+void QueryCache::attach( std::string path )
 {
-#if 0
-    auto e = this->extract( heap );
-    auto query = e.constant( true );
-    std::unordered_set< vm::HeapPointer > in_context{ _inc.begin(), _inc.end() };
-    auto head = ptr;
+    std::lock_guard< std::mutex > _lock( _mutex );
+
+    _fd = ::open( path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0666 );
+    if ( _fd < 0 )
+        brq::raise< brq::system_error >() << "opening " << path;
+
+    std::string data;
+    char buf[ 64 * 1024 ];
+    ssize_t got;
 
-    while ( !ptr.null() && !in_context.count( ptr ) )
+    while ( ( got = ::read( _fd, buf, sizeof( buf ) ) ) > 0 )
+        data.append( buf, got );
+    if ( got < 0 )
+        brq::raise< brq::system_error >() << "reading " << path;
+
+    size_t off = 0;
+    uint32_t size;
+
+    /* a record which was cut short (by a crash) is dropped, so that the next
+     * one starts at the right offset */
+    while ( off + sizeof( size ) <= data.size() )
     {
-        auto f = e.read( ptr );
-        auto clause = e.convert( f->binary.left );
-        query = mk_bin( e, Op::And, 1, query, clause );
-        ptr = f->binary.right;
+        std::memcpy( &size, data.data() + off, sizeof( size ) );
+        if ( off + sizeof( size ) + size + 1 > data.size() )
+            break;
+        item i{ data.substr( off + sizeof( size ), size ), bool( data[ off + sizeof( size ) + size ] ) };
+        _set.insert( i );
+        off += sizeof( size ) + size + 1;
     }
 
-    if ( head == ptr ) /* no new fragments */
+    if ( off < data.size() && ::ftruncate( _fd, off ) )
+        brq::raise< brq::system_error >() << "truncating " << path;
+}
+
+QueryKey query_key( const EqualQuery &q )
+{
+    QueryKey key( q.subsume ? 'S' : 'E' );
+
+    key.add( q.c_1 );
+    for ( auto &[ f_1, f_2 ] : q.pairs )
+        key.add( f_1 );
+
+    key.side();
+    key.add( q.c_2 );
+    for ( auto &[ f_1, f_2 ] : q.pairs )
+        key.add( f_2 );
+
+    return key;
+}
+
+QueryKey query_key( const FeasibleQuery &q )
+{
+    QueryKey key( 'F' );
+    for ( auto &expr : q )
+        key.add( expr );
+    return key;
+}
+
+template< typename Core >
+bool Incremental< Core >::feasible( vm::CowHeap &heap, const Assumes &as )
+{
+    feasibility_timer _t;
+    auto exprs = this->read_query( heap, as );
+    auto b = this->builder();
+    size_t common = 0;
+
+    while ( common < exprs.size() && common < _inc.size() && exprs[ common ] == _inc[ common ] )
+        ++ common;
+
+    if ( common == exprs.size() ) /* a prefix of the stack, which is satisfiable */
         return true;
 
-    while ( !_inc.empty() && _inc.back() != ptr )
-    {
-        _inc.pop_back();
+    auto key = query_key( exprs );
+    if ( auto hit = this->cache().find( key ) )
+        return *hit;
+
+    for ( ; _inc.size() > common; _inc.pop_back() )
         this->pop();
+
+    for ( size_t i = common; i < exprs.size(); ++i )
+    {
+        this->push();
+        auto query = evaluate( b, exprs[ i ] );
+        this->add( mk_bin( b, op_t::eq, 1, query, b.constant( 1, 1 ) ) );
+        _inc.push_back( exprs[ i ] );
+    }
+
+    auto r = this->solve();
+    this->cache().insert( key, r );
+
+    if ( r != Result::False )
+        return true;
+
+    for ( ; _inc.size() > common; _inc.pop_back() )
         this->pop();
+    return false;
+}
+
+#if OPT_STP && OPT_Z3
+
+struct Portfolio::Race
+{
+    std::mutex mutex;
+    std::condition_variable done;
+    std::optional< Result > result;
+    bool finished[ 2 ] = { false, false };
+    int winner = -1;
+};
+
+/* A thread which runs the jobs submitted to it, one at a time. A job which
+ * has not started yet can be withdrawn. */
+struct Portfolio::Worker
+{
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::function< void() > job;
+    bool quit = false;
+    std::thread thread;
+
+    Worker() : thread( [this]{ loop(); } ) {}
+
+    ~Worker()
+    {
+        {
+            std::lock_guard< std::mutex > _lock( mutex );
+            quit = true, job = nullptr;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    void loop()
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        while ( true )
+        {
+            wake.wait( lock, [&]{ return quit || job; } );
+            if ( quit )
+                return;
+            auto run = std::move( job );
+            job = nullptr;
+            lock.unlock();
+            run();
+            lock.lock();
+        }
     }
 
-    this->push();
-    this->add( query );
-    auto result = this->solve();
+    void submit( std::function< void() > f )
+    {
+        std::lock_guard< std::mutex > _lock( mutex );
+        ASSERT( !job );
+        job = std::move( f );
+        wake.notify_all();
+    }
 
-    if ( result == Result::True )
+    bool withdraw() /* true if the pending job was dropped before it started */
     {
-        this->push();
-        _inc.push_back( head );
+        std::lock_guard< std::mutex > _lock( mutex );
+        bool pending = bool( job );
+        job = nullptr;
+        return pending;
     }
+};
+
+Portfolio::Portfolio()
+    : _stp( std::make_shared< STP >() ), _z3( std::make_shared< Z3 >() ),
+      _stp_worker( std::make_unique< Worker >() ), _z3_worker( std::make_unique< Worker >() )
+{}
+
+Portfolio::~Portfolio() = default; /* waits for an STP run which lost */
+
+template< typename Query >
+Result Portfolio::race( const Query &q )
+{
+    auto state = std::make_shared< Race >();
+    auto query = std::make_shared< Query >( q ); /* must outlive a lost STP run */
+    auto start = __rdtsc();
+
+    auto run = [state, query]( auto solver, int id )
+    {
+        return [=]
+        {
+            auto r = solver->check( *query );
+            std::lock_guard< std::mutex > _lock( state->mutex );
+            state->finished[ id ] = true;
+            /* an unknown result only counts if the other solver has no answer either */
+            if ( !state->result && ( r != Result::Unknown || state->finished[ 1 - id ] ) )
+                state->result = r, state->winner = id;
+            state->done.notify_all();
+        };
+    };
+
+    /* if the STP run which lost the previous race is still going, this one
+     * starts when it is done, the worker holds no other jobs */
+    _stp_worker->submit( run( _stp, 0 ) );
+    _z3_worker->submit( run( _z3, 1 ) );
+
+    std::unique_lock< std::mutex > lock( state->mutex );
+    state->done.wait( lock, [&]{ return state->result.has_value(); } );
+
+    if ( state->winner == 0 )
+        stp_win_timer::record( __rdtsc() - start );
     else
-        this->pop();
+        z3_win_timer::record( __rdtsc() - start );
 
-    return result != Result::False;
-    #endif
+    auto r = *state->result;
+    lock.unlock();
+
+    _stp_worker->withdraw();
+    if ( _z3_worker->withdraw() )
+        return r;
+
+    /* the interrupt is lost if it comes before z3 starts solving, hence repeat */
+    lock.lock();
+    bool interrupted = !state->finished[ 1 ];
+    while ( !state->finished[ 1 ] )
+    {
+        _z3->interrupt();
+        state->done.wait_for( lock, std::chrono::milliseconds( 1 ) );
+    }
+
+    if ( interrupted ) /* the context may stay cancelled */
+        _z3 = std::make_shared< Z3 >();
+
+    return r;
 }
 
+Result Portfolio::check( const EqualQuery &q ) { return race( q ); }
+Result Portfolio::check( const FeasibleQuery &q ) { return race( q ); }
+
+#endif
+
 #if OPT_STP
 
 void STP::pop()
@@ -207,18 +501,15 @@ void STP::clear()
 #endif
 
 template struct Simple< SMTLib >;
-template struct Caching< SMTLib >;
 
 #if OPT_Z3
 template struct Simple< Z3 >;
 template struct Incremental< Z3 >;
-template struct Caching< Z3 >;
 #endif
 
 #if OPT_STP
 template struct Simple< STP >;
 template struct Incremental< STP >;
-template struct Caching< STP >;
 #endif
 
 }
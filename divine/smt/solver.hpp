@@ -25,6 +25,12 @@
 #include <vector>
 #include <brick-except>
 #include <brick-timer>
+#include <brick-proc>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 
 #if OPT_STP
 #include <stp/STPManager/STPManager.h>
@@ -41,8 +47,13 @@ namespace divine::smt
     struct feasibility_timer_tag;
     struct equality_timer_tag;
 
+    struct stp_win_timer_tag;
+    struct z3_win_timer_tag;
+
     using feasibility_timer = brq::timer< feasibility_timer_tag >;
     using equality_timer    = brq::timer< equality_timer_tag >;
+    using stp_win_timer     = brq::timer< stp_win_timer_tag >; /* --solver portfolio */
+    using z3_win_timer      = brq::timer< z3_win_timer_tag >;
 }
 
 namespace divine::smt::solver
@@ -51,11 +62,13 @@ namespace divine::smt::solver
 using namespace std::literals;
 
 using SymPairs = std::vector< std::pair< vm::HeapPointer, vm::HeapPointer > >;
+using Assumes = std::vector< vm::HeapPointer >;
 enum class Result { False, True, Unknown };
 
 struct None
 {
     bool equal( vm::HeapPointer, SymPairs &, vm::CowHeap &, vm::CowHeap & ) { return true; }
+    bool subsumes( vm::HeapPointer, SymPairs &, vm::CowHeap &, vm::CowHeap & ) { return true; }
 
     bool feasible( vm::CowHeap &, vm::HeapPointer a )
     {
@@ -64,47 +77,200 @@ struct None
         return true;
     }
 
+    bool feasible( vm::CowHeap &heap, const Assumes &as )
+    {
+        return as.empty() || feasible( heap, as.front() );
+    }
+
     void reset() {}
 };
 
+using expr_t = brq::smt_expr< std::vector >;
+
+/* The cache key of a query: the RPN forms of the formulas which make up the
+ * query, with the variables renumbered in the order of their first occurrence.
+ * Queries which only differ in the naming of variables thus share a key. The
+ * formulas of equal() come from two different heaps (sides), but a variable
+ * with the same id is the same variable in both, hence the numbering is
+ * shared. */
+struct QueryKey
+{
+    std::string _bytes;
+    std::unordered_map< brq::smt_varid_t, brq::smt_varid_t > _names;
+
+    QueryKey( char kind ) : _bytes( 1, kind ) {}
+    void side() { _bytes += '|'; }
+    void add( expr_t e );
+};
+
+/* Results of solver queries, shared by all solvers in the process (i.e. all
+ * threads of a verification job). If a file is attached, its content is loaded
+ * into the cache and each new result is appended to it, so that later runs
+ * (typically of the same program) do not need to solve the same queries
+ * again. Records are appended with a single write each, hence concurrent runs
+ * can share the file. */
+struct QueryCache
+{
+    struct item
+    {
+        std::string key;
+        bool sat;
+        auto hash() const { return brq::hash( reinterpret_cast< const uint8_t * >( key.data() ), key.size() ); }
+        bool operator==( const item &o ) const { return key == o.key; }
+    };
+
+    brq::concurrent_hash_set< item > _set;
+    std::atomic< int64_t > _hits = 0, _misses = 0;
+    std::mutex _mutex;
+    int _fd = -1;
+
+    std::optional< bool > find( const QueryKey &k );
+    void insert( const QueryKey &k, Result r );
+    void attach( std::string path );
+
+    static QueryCache &get()
+    {
+        static QueryCache cache;
+        return cache;
+    }
+};
+
+/* The formulas which make up a query, as read from the heap(s): the path
+ * conditions of the two states and the pairs of values which must be equal
+ * for equal() and subsumes(), all the assumptions for feasible(). Unlike the
+ * heaps, they can be handed over to another thread. */
+struct EqualQuery
+{
+    expr_t c_1, c_2;
+    std::vector< std::pair< expr_t, expr_t > > pairs;
+    bool subsume = false;
+};
+
+using FeasibleQuery = std::vector< expr_t >;
+
+QueryKey query_key( const EqualQuery &q );
+QueryKey query_key( const FeasibleQuery &q );
+
 template< typename Core >
 struct Simple : Core
 {
     using Core::Core;
-    bool equal( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 );
-    bool feasible( vm::CowHeap & heap, vm::HeapPointer assumes );
+    bool equal( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 )
+    {
+        equality_timer _t;
+        return check( read_query( path, sym_pairs, h1, h2 ) ) == Result::False;
+    }
+
+    /* each instance of the second state (h2) is also an instance of the first */
+    bool subsumes( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 )
+    {
+        equality_timer _t;
+        auto q = read_query( path, sym_pairs, h1, h2 );
+        q.subsume = true;
+        return check( q ) == Result::False;
+    }
+
+    /* all of the assumptions must hold at once */
+    bool feasible( vm::CowHeap &heap, const Assumes &as )
+    {
+        feasibility_timer _t;
+        return check( read_query( heap, as ) ) != Result::False;
+    }
+
+    bool feasible( vm::CowHeap &heap, vm::HeapPointer a ) { return feasible( heap, Assumes{ a } ); }
+
+    EqualQuery read_query( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 );
+    FeasibleQuery read_query( vm::CowHeap &heap, const Assumes &as );
+
+    /* an equality query is satisfiable if the states differ (or, with
+     * q.subsume, if the second is not covered by the first) */
+    Result check( const EqualQuery &q );
+    Result check( const FeasibleQuery &q );
 };
 
-template< typename Core >
-struct Incremental : Simple< Core >
+/* Answers repeated queries from the process-wide QueryCache. The Solver
+ * provides read_query() and check(), like Simple does. */
+template< typename Solver >
+struct Caching : Solver
 {
-    using Simple< Core >::Simple;
-    bool feasible( vm::CowHeap & heap, vm::HeapPointer assumes );
-    std::vector< vm::HeapPointer > _inc;
-    void reset() { _inc.clear(); Simple< Core >::reset(); }
+    using Solver::Solver;
+
+    bool equal( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 )
+    {
+        equality_timer _t;
+        return cached( this->read_query( path, sym_pairs, h1, h2 ) ) == Result::False;
+    }
+
+    bool subsumes( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 )
+    {
+        equality_timer _t;
+        auto q = this->read_query( path, sym_pairs, h1, h2 );
+        q.subsume = true;
+        return cached( q ) == Result::False;
+    }
+
+    bool feasible( vm::CowHeap &heap, const Assumes &as )
+    {
+        feasibility_timer _t;
+        return cached( this->read_query( heap, as ) ) != Result::False;
+    }
+
+    bool feasible( vm::CowHeap &heap, vm::HeapPointer a ) { return feasible( heap, Assumes{ a } ); }
+
+    template< typename Query >
+    Result cached( const Query &q )
+    {
+        auto key = query_key( q );
+        if ( auto hit = cache().find( key ) )
+            return *hit ? Result::True : Result::False;
+
+        auto r = this->check( q );
+        cache().insert( key, r );
+        return r;
+    }
+
+    QueryCache &cache() { return QueryCache::get(); }
 };
 
+/* Keeps the assumptions of the last query on the solver stack, one level per
+ * assumption. A query with the same initial assumptions (e.g. the next one
+ * along the same path, which only adds a few) only pops the levels which no
+ * longer match and asserts the new assumptions on top of the rest. The levels
+ * which remain on the stack are always satisfiable. */
 template< typename Core >
-struct Caching : Simple< Core >
+struct Incremental : Caching< Simple< Core > >
 {
-    struct item
+    using Base = Caching< Simple< Core > >;
+    using Base::Base;
+
+    bool feasible( vm::CowHeap &heap, const Assumes &as );
+    bool feasible( vm::CowHeap &heap, vm::HeapPointer a ) { return feasible( heap, Assumes{ a } ); }
+
+    bool equal( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 )
     {
-        brq::smt_expr< std::vector > key; /* TODO small vector */
-        mutable int hits:31;
-        bool sat:1;
-        auto hash() const { return brq::hash( key.base::data(), key.base::size() ); }
-        bool operator==( const item &o ) const { return key == o.key; }
-    };
+        reset(); /* a cached answer does not reach check(), which resets too */
+        return Base::equal( path, sym_pairs, h1, h2 );
+    }
+
+    bool subsumes( vm::HeapPointer path, SymPairs &sym_pairs, vm::CowHeap &h1, vm::CowHeap &h2 )
+    {
+        reset();
+        return Base::subsumes( path, sym_pairs, h1, h2 );
+    }
 
-    using Simple< Core >::Simple;
-    bool feasible( vm::CowHeap & heap, vm::HeapPointer assumes );
-    brq::concurrent_hash_set< item > _cache;
+    std::vector< expr_t > _inc; /* the assumption on each level of the stack */
+    void reset() { _inc.clear(); Base::reset(); }
 };
 
+/* The solver is a separate process (started on first use), driven over a
+ * pipe. Variables are declared once, at the outermost level, and each query
+ * is asserted inside a push/pop pair, hence the solver keeps its
+ * declarations (and whatever it learned about them) between queries. */
 struct SMTLib
 {
     using Options = std::vector< std::string >;
     SMTLib( const Options &opts ) : _opts{ opts } {}
+    SMTLib( const SMTLib &o ) : _opts( o._opts ) {} /* each copy runs its own solver */
 
     void reset() { _asserts.clear(); _ctx.clear(); }
     void add( brq::smtlib_node p ) { _asserts.push_back( p ); }
@@ -124,6 +290,9 @@ struct SMTLib
     std::vector< brq::smtlib_node > _asserts;
     brq::smtlib_context _ctx;
     Options _opts;
+
+    std::unique_ptr< brick::proc::Coprocess > _proc;
+    std::unordered_map< std::string, std::string > _declared; /* name → sort */
 };
 
 #if OPT_STP
@@ -183,6 +352,7 @@ struct Z3
     void push()            { _solver.push();  }
     void pop()             { _solver.pop();   }
     void reset()           { _solver.reset(); }
+    void interrupt()       { _ctx.interrupt(); } /* may be called from another thread */
 private:
     z3::context _ctx;
     z3::solver _solver;
@@ -190,20 +360,62 @@ private:
 
 #endif
 
+#if OPT_STP && OPT_Z3
+
+/* Runs each query in both STP and Z3 at once (each in a worker thread of its
+ * own, kept for the lifetime of the solver) and takes the first definite
+ * answer. The other solver is then cancelled: Z3 can be interrupted, but STP
+ * can not, hence an STP run which lost is left to finish in the background
+ * and the next query for STP waits for it. At most one such run is ever
+ * outstanding. */
+struct Portfolio
+{
+    using STP = Simple< solver::STP >;
+    using Z3 = Simple< solver::Z3 >;
+
+    struct Race;
+    struct Worker;
+
+    std::shared_ptr< STP > _stp;
+    std::shared_ptr< Z3 > _z3;
+    std::unique_ptr< Worker > _stp_worker, _z3_worker;
+
+    Portfolio();
+    Portfolio( const Portfolio & ) : Portfolio() {}
+    ~Portfolio();
+
+    template< typename... Args >
+    auto read_query( Args && ... args ) { return _z3->read_query( std::forward< Args >( args )... ); }
+
+    Result check( const EqualQuery &q );
+    Result check( const FeasibleQuery &q );
+
+    template< typename Query >
+    Result race( const Query &q );
+
+    void reset() {}
+};
+
+#endif
+
 }
 
 namespace divine::smt
 {
 
-using SMTLibSolver = solver::Caching< solver::SMTLib >;
+using SMTLibSolver = solver::Caching< solver::Simple< solver::SMTLib > >;
 using NoSolver = solver::None;
 
 #if OPT_Z3
-using Z3Solver = solver::Caching< solver::Z3 >;
+using Z3Solver = solver::Incremental< solver::Z3 >;
 #endif
 
 #if OPT_STP
-using STPSolver = solver::Caching< solver::STP >;
+using STPSolver = solver::Incremental< solver::STP >;
+#endif
+
+#if OPT_STP && OPT_Z3
+using PortfolioSolver = solver::Caching< solver::Portfolio >;
 #endif
 
 }
@@ -0,0 +1,83 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <divine/smt/solver.hpp>
+#include <brick-assert>
+
+#include <algorithm>
+
+namespace divine::t_smt
+{
+    template< typename Solver >
+    struct incremental
+    {
+        using expr_t = brq::smt_expr< std::vector >;
+        using op = brq::smt_op;
+
+        vm::CowHeap heap;
+        Solver solver;
+
+        /* an assumption 'x cmp val' on a 32-bit variable x */
+        vm::HeapPointer assume( op cmp, uint32_t val )
+        {
+            expr_t e;
+            e.apply( brq::smt_atom_t< brq::smt_varid_t >( op::var_i32, 1 ) );
+            e.apply( brq::smt_atom_t< uint32_t >( op::const_i32, val ) );
+            e.apply( cmp );
+
+            auto p = heap.make( e.base::size() + 1 ).cooked();
+            auto bytes = heap.unsafe_bytes( p );
+            std::copy( e.base::begin(), e.base::end(), bytes.begin() );
+            bytes[ e.base::size() ] = 0;
+            return p;
+        }
+
+        bool equal()
+        {
+            smt::solver::SymPairs pairs;
+            return solver.equal( vm::HeapPointer(), pairs, heap, heap );
+        }
+
+        /* an equality query answered from the cache must not leave the
+         * assumptions of the previous path on the solver stack */
+        TEST( cached_equal )
+        {
+            ASSERT( equal() ); /* fills the cache */
+            ASSERT( solver.feasible( heap, assume( op::bv_sgt, 1010 ) ) );
+            ASSERT( equal() );
+            ASSERT( solver.feasible( heap, assume( op::bv_slt, 1005 ) ) );
+        }
+
+        TEST( cached_subsumes )
+        {
+            smt::solver::SymPairs pairs;
+            ASSERT( solver.subsumes( vm::HeapPointer(), pairs, heap, heap ) );
+            ASSERT( solver.feasible( heap, assume( op::bv_sgt, 2010 ) ) );
+            ASSERT( solver.subsumes( vm::HeapPointer(), pairs, heap, heap ) );
+            ASSERT( solver.feasible( heap, assume( op::bv_slt, 2005 ) ) );
+        }
+    };
+
+#if OPT_Z3
+    template struct incremental< smt::Z3Solver >;
+#endif
+
+#if OPT_STP
+    template struct incremental< smt::STPSolver >;
+#endif
+}
@@ -0,0 +1,262 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <divine/ss/search.hpp>
+#include <divine/ss/external.hpp> /* has_dump, tests */
+
+#include <deque>
+#include <unordered_map>
+
+namespace divine::ss
+{
+
+/* A breadth-first search with the state space partitioned among the workers
+ * (peers), in the style of distributed-memory algorithms. Each state has an
+ * owner, given by the hash of its content, and only the owner ever looks the
+ * state up, stores it (in a table private to the peer) and expands it. The
+ * successors are forwarded unstored, along with the edge that leads to them,
+ * over a dedicated single-reader, single-writer channel for each pair of
+ * peers, hence the peers share no tables, queues or locks. As with External,
+ * the builder must not deduplicate states itself (see mc::Builder::partitioned)
+ * and it may provide hash(), equal() and release(). */
+
+template< typename B, typename L >
+struct Distributed : Search< B, L >
+{
+    using Super = Search< B, L >;
+    using typename Super::State;
+    using typename Super::Label;
+    using typename Super::Builder;
+    using typename Super::Listener;
+    using hash64_t = brq::hash64_t;
+
+    static constexpr bool custom = external::has_dump< B >::value;
+
+    struct Message
+    {
+        State from, to;
+        Label label;
+        hash64_t hash; /* of 'to', computed by the sender to pick the owner */
+        bool initial = false;
+    };
+
+    using Channel = shmem::Fifo< Message >;
+    using Table = std::unordered_map< hash64_t, std::vector< State > >;
+
+    struct Data
+    {
+        std::vector< Channel > channels;
+        std::vector< std::atomic< int64_t > > queued;
+        std::atomic< int64_t > states;
+        std::atomic< int > next_id;
+
+        Data( int peers ) : channels( peers * peers ), queued( peers ), states( 0 ), next_id( 0 ) {}
+    };
+
+    std::shared_ptr< Data > _x;
+
+    Distributed( const B &b, const L &l ) : Super( b, l ) {}
+
+    int64_t states() const { return _x ? _x->states.load() : 0; }
+
+    hash64_t hash( Builder &b, State st )
+    {
+        if constexpr ( custom ) return b.hash( st ); else return brq::impl::hash( st );
+    }
+
+    bool equal( Builder &b, State x, State y )
+    {
+        if constexpr ( custom ) return b.equal( x, y ); else return x == y;
+    }
+
+    void release( Builder &b, State st ) { if constexpr ( custom ) b.release( st ); }
+
+    /* the stored copy of 'st' and whether it is new */
+    std::pair< State, bool > store( Builder &b, Table &table, State st, hash64_t h )
+    {
+        auto &bucket = table[ h ];
+        for ( auto s : bucket )
+            if ( equal( b, s, st ) )
+            {
+                release( b, st );
+                return { s, false };
+            }
+        bucket.push_back( st );
+        ++ _x->states;
+        return { st, true };
+    }
+
+    void start( int thread_count ) override
+    {
+        const int peers = this->_thread_count = thread_count;
+        auto x = _x = std::make_shared< Data >( peers );
+        shmem::StartDetector start;
+        shmem::ApproximateCounter work;
+
+        auto owner = [=]( hash64_t h ) { return int( h % peers ); };
+        auto channel = [=]( int from, int to ) -> Channel & { return x->channels[ from * peers + to ]; };
+
+        this->qsize = [=]()
+        {
+            int64_t size = 0;
+            for ( auto &q : x->queued )
+                size += q.load( std::memory_order_relaxed );
+            return size;
+        };
+
+        auto builder = this->_builder;
+        auto listener = this->_listener;
+
+        this->_initials( listener, builder, [&]( auto st )
+        {
+            Message m;
+            m.to = st, m.hash = hash( builder, st ), m.initial = true;
+            channel( 0, owner( m.hash ) ).push( m ), ++ work;
+        } );
+
+        auto peer = [=]() mutable
+        {
+            auto _reg = this->_register( builder, listener );
+            int id = x->next_id++;
+            std::deque< State > queue;
+            Table table;
+            start.waitForAll( peers );
+            brick::types::Defer _( [&]() { this->_terminate->store( true ); } );
+
+            auto push = [&]( State st ) { queue.push_back( st ), ++ work; };
+
+            auto receive = [&]( Message &m )
+            {
+                auto [ st, isnew ] = store( builder, table, m.to, m.hash );
+                if ( m.initial )
+                {
+                    if ( isnew )
+                        push( st );
+                    return;
+                }
+
+                auto a = listener.edge( m.from, st, m.label, isnew );
+                if ( a == L::Terminate )
+                    this->_terminate->store( true ), throw typename Super::Terminate();
+                if ( a == L::Process || ( a == L::AsNeeded && isnew ) )
+                    this->_state( listener, st, isnew, [&]( bool ) { push( st ); } );
+            };
+
+            try {
+                while ( work && !this->_terminate->load() )
+                {
+                    for ( int from = 0; from < peers; ++from )
+                        for ( auto &ch = channel( from, id ); !ch.empty(); ch.pop(), -- work )
+                            receive( ch.front() );
+                    x->queued[ id ].store( queue.size(), std::memory_order_relaxed );
+
+                    if ( queue.empty() )
+                    {
+                        work.sync();
+                        continue;
+                    }
+
+                    auto v = queue.front();
+                    queue.pop_front();
+                    builder.edges( v, [&]( auto to, auto label, bool )
+                    {
+                        auto h = hash( builder, to );
+                        channel( id, owner( h ) ).push( Message{ v, to, label, h } ), ++ work;
+                    } );
+                    -- work;
+                }
+            } catch ( typename Super::Terminate ) {}
+
+            ASSERT( this->_terminate->load() || queue.empty() );
+        };
+
+        for ( int i = 0; i < peers; ++i )
+            this->_threads.emplace_back( std::async( std::launch::async, peer ) );
+    }
+
+    void start( int thread_count, std::string algorithm ) override
+    {
+        if ( algorithm != "distributed" )
+            brq::raise() << "the partitioned search does not support the " << algorithm << " order";
+        start( thread_count );
+    }
+};
+
+template< typename B, typename L >
+auto make_distributed( B b, L l )
+{
+    return Distributed< B, L >( b, l );
+}
+
+}
+
+namespace divine::t_ss
+{
+
+struct Distributed
+{
+    void _fixed( int peers )
+    {
+        Forgetful< ss::Fixed > builder{ { 1, 2 }, { 2, 3 }, { 1, 3 }, { 3, 4 }, { 4, 1 } };
+        std::atomic< int > edgecount( 0 ), statecount( 0 ), newcount( 0 );
+        auto s = ss::make_distributed( builder, ss::listen(
+                                           [&] ( auto, auto, auto, bool isnew )
+                                           {
+                                               ++ edgecount, newcount += isnew;
+                                               return ss::Listen::AsNeeded;
+                                           },
+                                           [&] ( auto ) { ++ statecount; return ss::Listen::AsNeeded; } ) );
+        s.start( peers );
+        s.wait();
+        ASSERT_EQ( edgecount.load(), 5 );
+        ASSERT_EQ( newcount.load(), 3 );
+        ASSERT_EQ( statecount.load(), 4 );
+        ASSERT_EQ( s.states(), 4 );
+    }
+
+    void _random( int peers )
+    {
+        for ( unsigned seed = 0; seed < 10; ++ seed )
+        {
+            Forgetful< ss::Random > builder{ 50, 120, seed };
+            std::atomic< int > edgecount( 0 ), statecount( 0 );
+            auto s = ss::make_distributed( builder, ss::passive_listen(
+                                               [&] ( auto, auto, auto ) { ++ edgecount; },
+                                               [&] ( auto ) { ++ statecount; } ) );
+            s.start( peers );
+            s.wait();
+            ASSERT_EQ( statecount.load(), 50 );
+            ASSERT_EQ( edgecount.load(), 120 );
+            ASSERT_EQ( s.states(), 50 );
+        }
+    }
+
+    TEST( fixed ) { _fixed( 1 ); }
+    TEST( random ) { _random( 1 ); }
+
+    TEST( parallel )
+    {
+        for ( int peers = 2; peers <= 3; ++peers )
+        {
+            _fixed( peers );
+            _random( peers );
+        }
+    }
+};
+
+}
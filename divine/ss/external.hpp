@@ -0,0 +1,698 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <divine/ss/search.hpp>
+#include <brick-except>
+#include <brick-fs>
+
+#include <cstdio>
+#include <cstring>
+#include <queue>
+
+namespace divine::ss
+{
+
+/* Supporting code for the external-memory breadth-first search below. All
+ * states are kept in 'segments', which are files of records sorted by the
+ * hash of the state. Segments are written and read sequentially; the only
+ * exception are the lookups which are used to reconstruct paths, which go
+ * through a sparse in-memory index. */
+
+namespace external
+{
+    using hash64_t = brq::hash64_t;
+
+    struct Record
+    {
+        hash64_t hash = 0, parent = 0;
+        std::vector< uint8_t > data;
+        bool operator<( const Record &o ) const { return hash < o.hash; }
+    };
+
+    struct Segment
+    {
+        static constexpr int stride = 256; /* records per index entry */
+        std::string path;
+        std::vector< std::pair< hash64_t, long > > index;
+        int64_t count = 0;
+    };
+
+    struct File
+    {
+        static constexpr int bufsize = 1024 * 1024;
+        std::FILE *_f;
+        std::unique_ptr< char[] > _buf;
+        std::string _path;
+
+        File( std::string path, const char *mode )
+            : _f( std::fopen( path.c_str(), mode ) ), _buf( new char[ bufsize ] ), _path( path )
+        {
+            if ( !_f )
+                brq::raise() << "could not open " << path << ": " << std::strerror( errno );
+            std::setvbuf( _f, _buf.get(), _IOFBF, bufsize );
+        }
+
+        File( const File & ) = delete;
+        ~File() { std::fclose( _f ); }
+
+        void write( const void *p, size_t n )
+        {
+            if ( n && std::fwrite( p, 1, n, _f ) != n )
+                brq::raise() << "error writing " << _path << ": " << std::strerror( errno );
+        }
+
+        bool read( void *p, size_t n )
+        {
+            if ( !n || std::fread( p, 1, n, _f ) == n )
+                return true;
+            if ( std::ferror( _f ) )
+                brq::raise() << "error reading " << _path << ": " << std::strerror( errno );
+            return false;
+        }
+
+        void seek( long off ) { std::fseek( _f, off, SEEK_SET ); }
+    };
+
+    struct Writer
+    {
+        Segment &_seg;
+        File _file;
+        long _offset = 0;
+
+        Writer( Segment &s ) : _seg( s ), _file( s.path, "wb" )
+        {
+            s.index.clear();
+            s.count = 0;
+        }
+
+        void write( const Record &r )
+        {
+            ASSERT( !_seg.count || _seg.index.back().first <= r.hash );
+            if ( _seg.count++ % Segment::stride == 0 )
+                _seg.index.emplace_back( r.hash, _offset );
+            uint32_t size = r.data.size();
+            _file.write( &r.hash, sizeof( r.hash ) );
+            _file.write( &r.parent, sizeof( r.parent ) );
+            _file.write( &size, sizeof( size ) );
+            _file.write( r.data.data(), size );
+            _offset += sizeof( r.hash ) + sizeof( r.parent ) + sizeof( size ) + size;
+        }
+    };
+
+    struct Reader
+    {
+        File _file;
+        Record _rec;
+        bool _valid = true;
+
+        Reader( const Segment &s, long offset = 0 ) : _file( s.path, "rb" )
+        {
+            if ( offset )
+                _file.seek( offset );
+            next();
+        }
+
+        bool valid() const { return _valid; }
+        Record &get() { return _rec; }
+
+        void next()
+        {
+            uint32_t size;
+            _valid = _file.read( &_rec.hash, sizeof( _rec.hash ) ) &&
+                     _file.read( &_rec.parent, sizeof( _rec.parent ) ) &&
+                     _file.read( &size, sizeof( size ) );
+            if ( !_valid )
+                return;
+            _rec.data.resize( size );
+            if ( !_file.read( _rec.data.data(), size ) )
+                brq::raise() << "truncated record in " << _file._path;
+        }
+    };
+
+    /* a k-way merge of sorted segments */
+    struct Merge
+    {
+        using Item = std::pair< hash64_t, int >;
+        std::vector< std::unique_ptr< Reader > > _in;
+        std::priority_queue< Item, std::vector< Item >, std::greater< Item > > _heap;
+
+        Merge( const std::vector< Segment > &segs )
+        {
+            for ( auto &s : segs )
+            {
+                _in.emplace_back( new Reader( s ) );
+                if ( _in.back()->valid() )
+                    _heap.emplace( _in.back()->get().hash, _in.size() - 1 );
+            }
+        }
+
+        bool empty() const { return _heap.empty(); }
+        hash64_t top() const { return _heap.top().first; }
+
+        Record pop()
+        {
+            int i = _heap.top().second;
+            _heap.pop();
+            Record r = std::move( _in[ i ]->get() );
+            _in[ i ]->next();
+            if ( _in[ i ]->valid() )
+                _heap.emplace( _in[ i ]->get().hash, i );
+            return r;
+        }
+    };
+
+    template< typename B, typename = void >
+    struct has_dump : std::false_type {};
+
+    template< typename B >
+    struct has_dump< B, std::void_t< decltype( std::declval< B & >().dump(
+            std::declval< typename B::State >(), std::declval< std::vector< uint8_t > & >() ) ) > >
+        : std::true_type {};
+}
+
+/* A breadth-first search with delayed duplicate detection, for state spaces
+ * which do not fit into memory. The search proceeds in layers: the states of
+ * the current layer are read from disk and expanded (in parallel) and their
+ * successors are collected in memory. Whenever the collected successors
+ * exceed the memory budget, they are sorted by hash and written out into a
+ * 'run'. Once the layer is done, the runs are merged and checked against all
+ * visited states in a single sequential pass, and the successors which turn
+ * out to be new form the next layer. To keep the number of files in check,
+ * old layers are periodically merged together, and so are the runs of a layer
+ * whenever there are too many of them to be merged in one go.
+ *
+ * The builder may provide hash(), equal(), dump(), undump(), forget() and
+ * release() to control how states are written to disk (see mc::Builder);
+ * otherwise, states are written out as raw bytes. In either case, the
+ * builder does not need to deduplicate states itself. */
+
+template< typename B, typename L >
+struct External : Search< B, L >
+{
+    using Super = Search< B, L >;
+    using typename Super::State;
+    using typename Super::Builder;
+    using typename Super::Listener;
+    using Record = external::Record;
+    using Segment = external::Segment;
+    using hash64_t = brq::hash64_t;
+
+    static constexpr bool custom = external::has_dump< B >::value;
+    static constexpr int max_segments = 8;
+    static constexpr int max_fanin = 16; /* runs merged at once, see collapse() */
+    static constexpr size_t default_budget = 512 * 1024 * 1024;
+
+    struct Data
+    {
+        brq::TempDir dir;
+        std::vector< Segment > visited;
+        std::atomic< int64_t > states, queued;
+        std::atomic< int > seq;
+        size_t budget = default_budget;
+
+        Data() : dir( "divine.XXXXXX", brq::AutoDelete::Yes, brq::UseSystemTemp::Yes ),
+                 states( 0 ), queued( 0 ), seq( 0 )
+        {}
+    };
+
+    std::shared_ptr< Data > _x;
+
+    External( const B &b, const L &l ) : Super( b, l ), _x( std::make_shared< Data >() ) {}
+
+    void budget( size_t b ) { if ( b ) _x->budget = b; }
+    int64_t states() const { return _x->states; }
+
+    hash64_t hash( Builder &b, State st )
+    {
+        if constexpr ( custom ) return b.hash( st ); else return brq::impl::hash( st );
+    }
+
+    bool equal( Builder &b, State x, State y )
+    {
+        if constexpr ( custom ) return b.equal( x, y ); else return x == y;
+    }
+
+    Record record( Builder &b, State st, hash64_t parent )
+    {
+        Record r;
+        r.hash = hash( b, st );
+        r.parent = parent;
+        if constexpr ( custom )
+            b.dump( st, r.data );
+        else
+        {
+            auto bytes = reinterpret_cast< const uint8_t * >( &st );
+            r.data.assign( bytes, bytes + sizeof( State ) );
+        }
+        return r;
+    }
+
+    State undump( Builder &b, const Record &r )
+    {
+        if constexpr ( custom )
+            return b.undump( r.data );
+        State st;
+        ASSERT_EQ( r.data.size(), sizeof( State ) );
+        std::memcpy( &st, r.data.data(), sizeof( State ) );
+        return st;
+    }
+
+    void forget( Builder &b, State st ) { if constexpr ( custom ) b.forget( st ); }
+    void release( Builder &b, State st ) { if constexpr ( custom ) b.release( st ); }
+
+    Segment segment()
+    {
+        Segment s;
+        s.path = brq::join_path( _x->dir.path, "segment." + std::to_string( _x->seq++ ) );
+        return s;
+    }
+
+    void remove( const std::vector< Segment > &segs )
+    {
+        for ( auto &s : segs )
+            brq::unlink( s.path );
+    }
+
+    Segment write( std::vector< Record > &recs )
+    {
+        Segment s = segment();
+        std::sort( recs.begin(), recs.end() );
+        external::Writer w( s );
+        for ( auto &r : recs )
+            w.write( r );
+        recs.clear();
+        return s;
+    }
+
+    /* expand all states in a layer and return the sorted runs of successors */
+    std::vector< Segment > expand( const Segment &layer )
+    {
+        external::Reader in( layer );
+        std::mutex mutex;
+        std::vector< Segment > runs;
+        size_t budget = _x->budget / this->_thread_count;
+
+        auto worker = [&]
+        {
+            auto builder = this->_builder;
+            auto listener = this->_listener;
+            auto _reg = this->_register( builder, listener );
+            std::vector< Record > buf;
+            size_t used = 0;
+
+            auto flush = [&]
+            {
+                if ( buf.empty() )
+                    return;
+                auto run = write( buf );
+                std::lock_guard< std::mutex > _lock( mutex );
+                runs.push_back( run );
+                used = 0;
+            };
+
+            try {
+                while ( !this->_terminate->load() )
+                {
+                    Record r;
+                    {
+                        std::lock_guard< std::mutex > _lock( mutex );
+                        if ( !in.valid() )
+                            break;
+                        r = std::move( in.get() );
+                        in.next();
+                    }
+
+                    -- _x->queued;
+                    State from = undump( builder, r );
+                    this->_succs( listener, builder, from,
+                                  [&]( auto st, auto, bool )
+                                  {
+                                      buf.push_back( record( builder, st, r.hash ) );
+                                      used += sizeof( Record ) + buf.back().data.size();
+                                      forget( builder, st );
+                                      if ( used > budget )
+                                          flush();
+                                  } );
+                    forget( builder, from );
+                }
+                flush();
+            } catch ( typename Super::Terminate ) {}
+        };
+
+        std::vector< std::future< void > > threads;
+        for ( int i = 0; i < this->_thread_count; ++i )
+            threads.emplace_back( std::async( std::launch::async, worker ) );
+        for ( auto &t : threads )
+            t.get();
+        return runs;
+    }
+
+    /* merge sorted segments into one (keeping duplicates) and remove them */
+    Segment combine( const std::vector< Segment > &segs )
+    {
+        Segment all = segment();
+        {
+            external::Merge in( segs );
+            external::Writer out( all );
+            while ( !in.empty() )
+                out.write( in.pop() );
+        }
+
+        remove( segs );
+        return all;
+    }
+
+    /* Each segment which is being merged holds a file (and its buffer) open,
+     * hence the runs are merged in groups of max_fanin, over as many passes
+     * as it takes, until merge() can take the rest at once. */
+    void collapse( std::vector< Segment > &runs )
+    {
+        while ( int( runs.size() ) > max_fanin && !this->_terminate->load() )
+        {
+            std::vector< Segment > next;
+            for ( size_t i = 0; i < runs.size(); i += max_fanin )
+            {
+                auto end = runs.begin() + std::min( runs.size(), i + max_fanin );
+                std::vector< Segment > group( runs.begin() + i, end );
+                next.push_back( group.size() == 1 ? group[ 0 ] : combine( group ) );
+            }
+            runs = std::move( next );
+        }
+    }
+
+    /* Merge the runs and remove all successors which have been seen before,
+     * either in an earlier layer or in the same one. Since the records are
+     * sorted, we only need to compare the (rare) records with equal hashes. */
+    Segment merge( const std::vector< Segment > &runs, Builder &b, Listener &l )
+    {
+        external::Merge cand( runs ), seen( _x->visited );
+        Segment next = segment();
+        external::Writer out( next );
+
+        while ( !cand.empty() && !this->_terminate->load() )
+        {
+            hash64_t h = cand.top();
+            std::vector< std::pair< Record, State > > old, group;
+
+            while ( !seen.empty() && seen.top() < h )
+                seen.pop();
+            while ( !seen.empty() && seen.top() == h )
+            {
+                Record r = seen.pop();
+                State st = undump( b, r );
+                old.emplace_back( std::move( r ), st );
+            }
+
+            auto known = [&]( auto &set, const Record &r, State st )
+            {
+                for ( auto &[ o_rec, o_st ] : set )
+                    if ( o_rec.data == r.data || equal( b, st, o_st ) )
+                        return true;
+                return false;
+            };
+
+            while ( !cand.empty() && cand.top() == h )
+            {
+                Record r = cand.pop();
+                State st = undump( b, r );
+
+                if ( known( old, r, st ) || known( group, r, st ) )
+                    release( b, st );
+                else
+                    group.emplace_back( std::move( r ), st );
+            }
+
+            for ( auto &[ r, st ] : group )
+            {
+                bool push = false;
+                this->_state( l, st, true, [&]( bool ) { push = true; } );
+                if ( push )
+                    out.write( r ), ++ _x->states, ++ _x->queued;
+                forget( b, st );
+            }
+
+            for ( auto &o : old )
+                forget( b, o.second );
+        }
+
+        remove( runs );
+        return next;
+    }
+
+    /* old segments are merged into one to limit the number of open files */
+    void consolidate()
+    {
+        if ( int( _x->visited.size() ) < max_segments )
+            return;
+
+        _x->visited = { combine( _x->visited ) };
+    }
+
+    void run()
+    {
+        auto builder = this->_builder;
+        auto listener = this->_listener;
+        brick::types::Defer _( [&]() { this->_terminate->store( true ); } );
+
+        try {
+            std::vector< Record > init;
+            this->_initials( listener, builder,
+                             [&]( auto st ) { init.push_back( record( builder, st, 0 ) ); } );
+            _x->states += init.size();
+            _x->queued += init.size();
+            Segment layer = write( init );
+            _x->visited.push_back( layer );
+
+            while ( layer.count && !this->_terminate->load() )
+            {
+                auto runs = expand( layer );
+                collapse( runs );
+                if ( this->_terminate->load() )
+                    return remove( runs );
+                layer = merge( runs, builder, listener );
+                consolidate();
+                _x->visited.push_back( layer );
+            }
+        } catch ( typename Super::Terminate ) {}
+    }
+
+    /* does 'to' appear among the successors of 'from'? */
+    bool succeeds( Builder &b, State from, State to )
+    {
+        bool found = false;
+        b.edges( from, [&]( auto st, auto, bool )
+        {
+            found = found || equal( b, st, to );
+            release( b, st );
+        } );
+        return found;
+    }
+
+    /* Reconstruct the path from an initial state to the given state. Only
+     * the hash of the parent is recorded, hence a candidate parent is only
+     * accepted if the current state is really one of its successors. */
+    std::vector< State > path( State st )
+    {
+        auto &b = this->_builder;
+        std::vector< State > rv{ st };
+        hash64_t h = hash( b, st ), parent = 0;
+        bool found = false;
+
+        for ( auto &r : lookup( h ) )
+            if ( equal( b, st, undump( b, r ) ) )
+            {
+                parent = r.parent, found = true;
+                break;
+            }
+
+        if ( !found )
+            brq::raise() << "state not found on disk";
+
+        while ( parent )
+        {
+            found = false;
+            for ( auto &r : lookup( parent ) )
+            {
+                State p = undump( b, r );
+                if ( succeeds( b, p, rv.back() ) )
+                {
+                    rv.push_back( p );
+                    parent = r.parent, found = true;
+                    break;
+                }
+                forget( b, p );
+            }
+
+            if ( !found )
+                brq::raise() << "the parent of a state not found on disk";
+        }
+
+        std::reverse( rv.begin(), rv.end() );
+        return rv;
+    }
+
+    std::vector< Record > lookup( hash64_t h )
+    {
+        std::vector< Record > rv;
+
+        for ( auto &s : _x->visited )
+        {
+            auto i = std::lower_bound( s.index.begin(), s.index.end(), std::make_pair( h, 0l ) );
+            if ( i == s.index.begin() && ( i == s.index.end() || i->first > h ) )
+                continue;
+            if ( i != s.index.begin() )
+                --i;
+
+            for ( external::Reader in( s, i->second ); in.valid() && in.get().hash <= h; in.next() )
+                if ( in.get().hash == h )
+                    rv.push_back( in.get() );
+        }
+
+        return rv;
+    }
+
+    void start( int thread_count ) override
+    {
+        this->_thread_count = thread_count;
+        this->qsize = [x = _x]() { return x->queued.load(); };
+        this->_threads.emplace_back( std::async( std::launch::async, [this] { run(); } ) );
+    }
+
+    void start( int thread_count, std::string algorithm ) override
+    {
+        if ( algorithm != "bfs" && algorithm != "BFS" )
+            brq::raise() << "external storage only supports the bfs search order";
+        start( thread_count );
+    }
+};
+
+template< typename B, typename L >
+auto make_external( B b, L l )
+{
+    return External< B, L >( b, l );
+}
+
+}
+
+namespace divine::t_ss
+{
+
+/* report all successors as new, leaving duplicate detection to the search */
+template< typename B >
+struct Forgetful : B
+{
+    using B::B;
+
+    template< typename Y >
+    void edges( int from, Y yield )
+    {
+        B::edges( from, [&]( auto st, auto label, bool ) { yield( st, label, true ); } );
+    }
+};
+
+/* a (very) poor hash function, so that the parents can not be told apart by
+ * their hash alone */
+struct Colliding : Forgetful< ss::Fixed >
+{
+    using Forgetful< ss::Fixed >::Forgetful;
+
+    brq::hash64_t hash( int st ) { return st % 2 + 1; }
+    bool equal( int a, int b ) { return a == b; }
+    void release( int ) {}
+    void forget( int ) {}
+
+    void dump( int st, std::vector< uint8_t > &out )
+    {
+        auto bytes = reinterpret_cast< const uint8_t * >( &st );
+        out.insert( out.end(), bytes, bytes + sizeof( st ) );
+    }
+
+    int undump( const std::vector< uint8_t > &data )
+    {
+        int st;
+        std::memcpy( &st, data.data(), sizeof( st ) );
+        return st;
+    }
+};
+
+struct External
+{
+    void _fixed( int threads, size_t budget )
+    {
+        Forgetful< ss::Fixed > builder{ { 1, 2 }, { 2, 3 }, { 1, 3 }, { 3, 4 }, { 4, 1 } };
+        std::atomic< int > edgecount( 0 ), statecount( 0 );
+        auto s = ss::make_external( builder, ss::passive_listen(
+                                        [&] ( auto, auto, auto ) { ++ edgecount; },
+                                        [&] ( auto ) { ++ statecount; } ) );
+        s.budget( budget );
+        s.start( threads );
+        s.wait();
+        ASSERT_EQ( edgecount.load(), 5 );
+        ASSERT_EQ( statecount.load(), 4 );
+        ASSERT_EQ( s.states(), 4 );
+    }
+
+    void _random( int threads, size_t budget )
+    {
+        for ( unsigned seed = 0; seed < 10; ++ seed )
+        {
+            Forgetful< ss::Random > builder{ 50, 120, seed };
+            std::atomic< int > edgecount( 0 ), statecount( 0 );
+            auto s = ss::make_external( builder, ss::passive_listen(
+                                            [&] ( auto, auto, auto ) { ++ edgecount; },
+                                            [&] ( auto ) { ++ statecount; } ) );
+            s.budget( budget );
+            s.start( threads );
+            s.wait();
+            ASSERT_EQ( statecount.load(), 50 );
+            ASSERT_EQ( edgecount.load(), 120 );
+
+            for ( int i = 1; i <= 50; ++i )
+            {
+                auto p = s.path( i );
+                ASSERT_EQ( p.front(), 1 );
+                ASSERT_EQ( p.back(), i );
+            }
+        }
+    }
+
+    TEST( path_collision )
+    {
+        Colliding builder{ { 1, 2 }, { 1, 4 }, { 4, 3 }, { 2, 5 } };
+        auto s = ss::make_external( builder, ss::passive_listen() );
+        s.start( 1 );
+        s.wait();
+        ASSERT_EQ( s.states(), 5 );
+        ASSERT( s.path( 3 ) == std::vector< int >( { 1, 4, 3 } ) );
+        ASSERT( s.path( 5 ) == std::vector< int >( { 1, 2, 5 } ) );
+    }
+
+    TEST( fixed ) { _fixed( 1, 0 ); }
+    TEST( fixed_spill ) { _fixed( 1, 1 ); } /* every successor goes into its own run */
+    TEST( random ) { _random( 1, 0 ); }
+    TEST( random_spill ) { _random( 1, 64 ); }
+    TEST( random_fanin ) { _random( 1, 1 ); } /* more runs than can be merged at once */
+
+    TEST( random_parallel )
+    {
+        _random( 2, 0 );
+        _random( 3, 64 );
+    }
+};
+
+}
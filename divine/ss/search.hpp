@@ -5,6 +5,7 @@
 #include <future>
 #include <vector>
 #include <stack>
+#include <optional>
 
 #include <brick-shmem>
 
@@ -27,7 +28,7 @@ struct Job
     std::function< int64_t() > qsize;
 };
 
-enum class Order { PseudoBFS, DFS, myDFS };
+enum class Order { PseudoBFS, DFS };
 
 template< typename B, typename L >
 struct Search : Job
@@ -63,8 +64,6 @@ struct Search : Job
             order( ss::Order::PseudoBFS );
         else if ( alg == "DFS" || alg == "dfs" )
             order( ss::Order::DFS );
-        else if ( alg == "myDFS" || alg == "mydfs" )
-            order( ss::Order::myDFS );
         else
             UNREACHABLE( "unsupported algorithm", alg );
     }
@@ -214,12 +213,73 @@ struct Search : Job
         };
     }
 
-    Worker myDFS() {
-        std::cout << "In function myDFS()\n";
-        NOT_IMPLEMENTED(); 
-    }
+    /* A parallel DFS: each worker explores depth-first from its own deque
+     * and steals the shallowest pending state of some other worker when it
+     * runs dry. Since parts of the subtree of a state may be finished by
+     * another thread, there is no meaningful post-order and closed() is not
+     * reported. */
+    Worker parallelDFS()
+    {
+        using Deque = shmem::StealingDeque< State >;
+        auto deques = std::make_shared< std::vector< Deque > >( _thread_count );
+        auto next_id = std::make_shared< std::atomic< int > >( 0 );
+        shmem::StartDetector start;
+        shmem::ApproximateCounter work;
+
+        qsize = [=]()
+        {
+            int64_t size = 0;
+            for ( auto &d : *deques )
+                size += d.size();
+            return size;
+        };
+
+        auto builder = _builder;
+        auto listener = _listener;
+
+        _initials( listener, builder,
+                   [&]( auto st ) { deques->front().push( st ), ++ work; } );
+
+        return [=]() mutable
+        {
+            auto _reg = _register( builder, listener );
+            int id = ( *next_id )++;
+            auto &local = ( *deques )[ id ];
+            start.waitForAll( _thread_count );
+            brick::types::Defer _( [&]() { _terminate->store( true ); } );
+
+            auto steal = [&]
+            {
+                std::optional< State > v;
+                for ( int i = 1; i < _thread_count && !v; ++i )
+                    v = ( *deques )[ ( id + i ) % _thread_count ].steal();
+                return v;
+            };
+
+            try {
+                while ( work && !_terminate->load() )
+                {
+                    auto v = local.pop();
+                    if ( !v )
+                        v = steal();
+                    if ( !v )
+                    {
+                        work.sync();
+                        continue;
+                    }
+                    _succs( listener, builder, *v,
+                            [&]( auto s, auto, bool isnew )
+                            {
+                                _state( listener, s, isnew,
+                                        [&]( bool ) { local.push( s ), ++ work; } );
+                            } );
+                    -- work;
+                }
+            } catch ( Terminate ) {}
 
-    Worker distributedBFS() { NOT_IMPLEMENTED(); }
+            ASSERT( _terminate->load() || local.empty() );
+        };
+    }
 
     void start( int thread_count ) override
     {
@@ -229,8 +289,7 @@ struct Search : Job
         switch ( _order )
         {
             case Order::PseudoBFS: blueprint = pseudoBFS(); break;
-            case Order::DFS: blueprint = DFS(); break;
-            case Order::myDFS: blueprint = myDFS(); break;
+            case Order::DFS: blueprint = _thread_count > 1 ? parallelDFS() : DFS(); break;
         }
 
         for ( int i = 0; i < _thread_count; ++i )
@@ -239,6 +298,7 @@ struct Search : Job
 
     void start( int thread_count, std::string algorithm ) override
     {
+        set_alg( algorithm );
         start( thread_count );
     }
 
@@ -351,6 +411,31 @@ struct Search
         _random( ss::Order::PseudoBFS, 3 );
     }
 
+    TEST( dfs_fixed_parallel )
+    {
+        _fixed( ss::Order::DFS, 2 );
+        _fixed( ss::Order::DFS, 3 );
+    }
+
+    TEST( dfs_random_parallel )
+    {
+        _random( ss::Order::DFS, 2 );
+        _random( ss::Order::DFS, 3 );
+    }
+
+    TEST( start_alg )
+    {
+        ss::Fixed builder{ { 1, 2 }, { 2, 3 } };
+        int statecount = 0;
+        auto s = ss::make_search( builder, ss::passive_listen(
+                                      [] ( auto, auto, auto ) {},
+                                      [&] ( auto ) { ++ statecount; } ) );
+        s.start( 1, "dfs" );
+        s.wait();
+        ASSERT( s._order == ss::Order::DFS );
+        ASSERT_EQ( statecount, 3 );
+    }
+
     TEST( sequence )
     {
         std::vector< std::pair< int, int > > vec;
@@ -356,11 +356,18 @@ void with_bc::init()
 {
     ASSERT( !_init_done );
 
-    _log->loader( Phase::DiOS );
-    _bc->do_dios();
+    if ( !_program_cache.empty() )
+        _bc->program_cache( _program_cache, version() );
 
-    _log->loader( Phase::LART );
-    _bc->do_lart();
+    if ( !_bc->load_cached() )
+    {
+        _log->loader( Phase::DiOS );
+        _bc->do_dios();
+
+        _log->loader( Phase::LART );
+        _bc->do_lart();
+        _bc->save_cached();
+    }
 
     if ( !_dump_bc.empty() )
         brick::llvm::writeModule( _bc->_module.get(), _dump_bc );
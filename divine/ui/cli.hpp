@@ -190,7 +190,7 @@ namespace divine::ui
         arg::mem _vfs_limit = 16 * 1024 * 1024;
         bool _init_done = false;
         SinkPtr _log = nullsink();
-        std::string _dump_bc;
+        std::string _dump_bc, _program_cache;
         rt::DiosCC _cc_driver;
 
         virtual void process_options();
@@ -239,6 +239,8 @@ namespace divine::ui
             c.opt( "--symbolic", _bc_opts.symbolic ) << "enable semi-symbolic data representation";
             c.opt( "--svcomp", _bc_opts.svcomp ) << "work around SV-COMP quirks";
             c.opt( "--dump-bc", _dump_bc ) << "dump the transformed bitcode into a file";
+            c.opt( "--program-cache", _program_cache )
+                << "reuse the transformed bitcode stored in a directory";
             c.opt( "--mcsema", _bc_opts.mcsema ) << "bitcode was produced by mcsema";
             c.pos( _bc_opts.input_file, true );
             c.collect( _useropts );
@@ -303,7 +305,16 @@ namespace divine::ui
         brq::cmd_flag _liveness;
         bool _interactive = true;
         std::string _solver = "stp";
-        std::string _alg = "BFS";
+        std::string _smt_cache;
+        std::string _search_order = "bfs";
+        mc::storage _storage = mc::storage::exact;
+        arg::mem _storage_size = 0;
+        brq::cmd_flag _tree_compression;
+        brq::cmd_flag _por;
+        brq::cmd_flag _symmetry;
+        brq::cmd_flag _subsumption;
+        std::string _checkpoint, _resume;
+        int _checkpoint_period = 600; // seconds
 
         void setup() override;
         void run() override;
@@ -338,7 +349,17 @@ namespace divine::ui
             c.opt( "--max-time", _max_time ) << "set a time limit (in seconds)";
             c.opt( "--liveness", _liveness ) << "enable verification of liveness properties";
             c.opt( "--solver", _solver ) << "select a constraint solver to use in --symbolic mode";
-            c.opt( "--alg", _alg ) << "select a verification algorithm to use";
+            c.opt( "--smt-cache", _smt_cache ) << "keep solver results in a file, for use by later runs";
+            c.opt( "--search-order", _search_order ) << "state space exploration order (bfs, dfs, distributed) [bfs]";
+            c.opt( "--storage", _storage ) << "visited state storage (exact, compact, bitstate, external) [exact]";
+            c.opt( "--storage-size", _storage_size ) << "memory for compact, bitstate or external storage [512MiB]";
+            c.opt( "--tree-compression", _tree_compression ) << "store states as hash-consed trees of heap objects";
+            c.opt( "--por", _por ) << "only explore one thread where its steps are independent of the others";
+            c.opt( "--symmetry", _symmetry ) << "identify states which only differ in the order of threads";
+            c.opt( "--subsumption", _subsumption ) << "do not explore symbolic states covered by a visited state";
+            c.opt( "--checkpoint", _checkpoint ) << "periodically save the search into a file";
+            c.opt( "--checkpoint-period", _checkpoint_period ) << "seconds between two checkpoints [600]";
+            c.opt( "--resume", _resume ) << "continue a search saved by --checkpoint";
         }
     };
 
@@ -64,7 +64,7 @@ namespace divine::ui
         else
             exec.run( _exhaustive, _tactic ); // TODO: What about trace?
 
-        _log->progress( { 0, 0 }, 0, true );
+        _log->progress( exec.stats(), 0, true );
         _log->memory( exec.poolstats(), mc::HashStats(), true ); // TODO: What about HashStats?
 
         report_options();
@@ -74,6 +74,8 @@ void print_timers( std::ostream &ostr, std::string name )
     ostr << "cycle timers (" << name << "):" << std::endl;
     print_timer< smt::feasibility_timer >( ostr, "smt-f" );
     print_timer< smt::equality_timer >( ostr, "smt-eq" );
+    print_timer< smt::stp_win_timer >( ostr, "smt-stp-wins" );
+    print_timer< smt::z3_win_timer >( ostr, "smt-z3-wins" );
     print_timer< mc::divm_timer >( ostr, "divm" );
     print_timer< mc::hash_timer >( ostr, "hash" );
 }
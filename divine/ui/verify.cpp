@@ -57,6 +57,56 @@ void verify::setup()
 
     if ( _bc_opts.symbolic )
         bitcode()->solver( _solver );
+
+    if ( !_smt_cache.empty() && !_bc_opts.symbolic )
+        brq::raise() << "--smt-cache requires --symbolic";
+    if ( !_smt_cache.empty() )
+        smt::solver::QueryCache::get().attach( _smt_cache );
+
+    if ( _search_order != "bfs" && _search_order != "dfs" && _search_order != "distributed" )
+        brq::raise() << "unknown --search-order " << _search_order << " (use bfs, dfs or distributed)";
+    if ( _search_order != "bfs" && _liveness )
+        brq::raise() << "--search-order " << _search_order << " is not supported with --liveness";
+
+    if ( _liveness && _storage != mc::storage::exact )
+        brq::raise() << "--storage " << mc::to_string( _storage ) << " is not supported with --liveness";
+
+    bitcode()->storage( _storage, _storage_size.size );
+
+    if ( _tree_compression && _liveness )
+        brq::raise() << "--tree-compression is not supported with --liveness";
+    if ( _tree_compression && _storage != mc::storage::exact )
+        brq::raise() << "--tree-compression is not supported with --storage " << mc::to_string( _storage );
+    bitcode()->tree_compression( _tree_compression );
+
+    if ( _por && _liveness )
+        brq::raise() << "--por is not supported with --liveness";
+    bitcode()->por( _por );
+
+    if ( _symmetry && _liveness )
+        brq::raise() << "--symmetry is not supported with --liveness";
+    bitcode()->symmetry( _symmetry );
+
+    if ( _subsumption && !_bc_opts.symbolic )
+        brq::raise() << "--subsumption requires --symbolic";
+    if ( _subsumption && _liveness )
+        brq::raise() << "--subsumption is not supported with --liveness";
+    bitcode()->subsumption( _subsumption );
+
+    if ( _checkpoint.empty() && _resume.empty() )
+        return;
+    if ( _liveness )
+        brq::raise() << "checkpoints are not supported with --liveness";
+    if ( _storage != mc::storage::exact )
+        brq::raise() << "checkpoints are not supported with --storage " << mc::to_string( _storage );
+    if ( _bc_opts.symbolic )
+        brq::raise() << "checkpoints are not supported with --symbolic";
+    if ( _tree_compression )
+        brq::raise() << "checkpoints are not supported with --tree-compression";
+    if ( _search_order == "distributed" )
+        brq::raise() << "checkpoints are not supported with --search-order distributed";
+    if ( _checkpoint_period <= 0 )
+        brq::raise() << "--checkpoint-period must be positive";
 }
 
 void check::setup()
@@ -134,13 +184,18 @@ void verify::safety()
 
     auto safety = mc::make_job< mc::Safety >( bitcode(), ss::passive_listen() );
 
+    if ( !_resume.empty() )
+        safety->resume( _resume );
+    if ( !_checkpoint.empty() )
+        safety->checkpoint( _checkpoint, std::chrono::seconds( _checkpoint_period ) );
+
     SysInfo sysinfo;
     sysinfo.setMemoryLimitInBytes( _max_mem.size );
 
     _log->start();
     int ps_ctr = 0;
 
-    safety->start( _threads, _alg, [&]( bool last )
+    safety->start( _threads, _search_order, [&]( bool last )
                    {
                        _log->progress( safety->stats(),
                                        safety->queuesize(), last );
@@ -152,8 +207,26 @@ void verify::safety()
     safety->wait();
     report_options();
     _log->info( "smt solver: " + _solver + "\n", true );
+    _log->info( "search order: " + _search_order + "\n", true );
     _log->info( "property type: safety\n", true );
 
+    if ( _storage != mc::storage::exact )
+        _log->info( "storage: " + mc::to_string( _storage ) + "\n", true );
+
+    if ( _bc_opts.symbolic )
+    {
+        auto &cache = smt::solver::QueryCache::get();
+        _log->info( "smt cache hits: " + std::to_string( cache._hits ) + "\n", true );
+        _log->info( "smt cache misses: " + std::to_string( cache._misses ) + "\n", true );
+    }
+
+    if ( _storage == mc::storage::compact || _storage == mc::storage::bitstate )
+    {
+        auto omitted = safety->omissions();
+        _log->info( "expected omitted states: " + std::to_string( omitted ) + "\n", true );
+        _log->info( "omission probability: " + std::to_string( 1 - std::exp( -omitted ) ) + "\n", true );
+    }
+
     if ( safety->result() == mc::Result::Valid )
         return _log->result( safety->result(), mc::Trace() );
 
@@ -162,10 +235,13 @@ void verify::safety()
 
 void verify::liveness()
 {
+    if ( !_threads )
+        _threads = std::min( 4u, std::thread::hardware_concurrency() );
+
     auto liveness = mc::make_job< mc::Liveness >( bitcode(), ss::passive_listen() );
 
     _log->start();
-    liveness->start( 1, [&]( bool last )
+    liveness->start( _threads, [&]( bool last )
                    {
                        _log->progress( liveness->stats(),
                                        liveness->queuesize(), last );
@@ -94,15 +94,17 @@ void Program::initConstant( Program::Slot v, llvm::Value *V )
     if ( auto CE = dyn_cast< llvm::ConstantExpr >( V ) )
     {
         Instruction comp;
+        std::vector< Slot > values;
         comp.opcode = CE->getOpcode();
         comp.subcode = initSubcode( CE );
-        comp.values.push_back( v ); /* the result comes first */
+        values.push_back( v ); /* the result comes first */
         for ( int i = 0; i < int( C->getNumOperands() ); ++i ) // now the operands
         {
             if ( !valuemap.count( C->getOperand( i ) ) )
                 UNREACHABLE( "constant's operand not processed yet:", C, "operand:", C->getOperand( i ) );
-            comp.values.push_back( valuemap[ C->getOperand( i ) ] );
+            values.push_back( valuemap[ C->getOperand( i ) ] );
         }
+        comp.bind( values.data(), values.size() );
         eval._instruction = &comp;
         eval.dispatch(); /* compute and write out the value */
     }
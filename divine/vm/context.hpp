@@ -32,6 +32,7 @@ namespace divine::vm::ctx
     using common = compose< track_nothing, snapshot, ptr2i, base< prog, heap > >;
     using with_tracking = compose< track_loops, track_nothing >;
     using with_debug = compose< legacy, fault, debug >;
+    using without_debug = compose< legacy, fault, nodebug >;
 }
 
 namespace divine::vm
@@ -41,6 +42,11 @@ namespace divine::vm
     template< typename prog, typename heap >
     struct Context : compose_stack< ctx::with_debug, ctx::with_tracking, ctx::common< prog, heap > > {};
 
+    /* Same as Context, but without debug mode (see ctx::nodebug). */
+    template< typename prog, typename heap >
+    struct SearchContext : compose_stack< ctx::without_debug, ctx::with_tracking,
+                                          ctx::common< prog, heap > > {};
+
     template< typename prog, typename heap >
     struct ctx_const : compose_stack< ctx::track_nothing, ctx::common< prog, heap > >
     {
@@ -219,6 +219,7 @@ namespace divine::vm::ctx
     {
         bool enter_debug() { return false; }
         void leave_debug() {}
+        void abandon_debug() {}
         bool debug_allowed() { return false; }
         bool debug_mode() { return false; }
 
@@ -245,6 +246,7 @@ namespace divine::vm::ctx
         virtual void trace( TraceAssume ) {}
         virtual void trace( TraceConstraints ) {}
         virtual void trace( TraceLeakCheck ) {}
+        virtual void trace( TraceSymmetric ) {}
         virtual void trace( std::string ) {}
         virtual ~ctx_trace() {}
     };
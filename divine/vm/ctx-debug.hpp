@@ -60,6 +60,14 @@ namespace divine::vm::ctx
         bool enter_debug();
         void leave_debug();
 
+        void abandon_debug()
+        {
+            this->trace( "W: " + this->fault_str() + " in debug mode (abandoned)" );
+            this->fault_clear();
+            _debug_depth = 0; /* short-circuit */
+            leave_debug();
+        }
+
         void debug_save();
         void debug_restore();
 
@@ -112,4 +120,35 @@ namespace divine::vm::ctx
     };
 
     using debug = m< debug_i >;
+
+    /* A replacement for debug_i in contexts which never enter debug mode,
+     * like the one used by the state space search: dbg.call is skipped (and
+     * not counted as an instruction) and the debug mode checks all over the
+     * interpreter are compile-time constants. Interrupts are still recorded,
+     * since they are part of the edge labels. */
+
+    template< typename next >
+    struct nodebug_i : next
+    {
+        std::vector< Interrupt > _interrupts;
+
+        static constexpr const bool has_debug_mode = false;
+
+        bool track_test( Interrupt::Type t, CodePointer pc )
+        {
+            _interrupts.push_back( Interrupt{ t, this->_state.instruction_counter, pc } );
+            return true;
+        }
+
+        static constexpr bool debug_allowed() { return false; }
+        static constexpr bool debug_mode() { return false; }
+
+        bool enter_debug()
+        {
+            -- this->_state.instruction_counter; /* dbg.call does not count */
+            return false;
+        }
+    };
+
+    using nodebug = m< nodebug_i >;
 }
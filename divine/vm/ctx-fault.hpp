@@ -40,12 +40,7 @@ namespace divine::vm::ctx
         {
             auto fh = this->fault_handler();
             if ( this->debug_mode() )
-            {
-                this->trace( "W: " + this->fault_str() + " in debug mode (abandoned)" );
-                this->fault_clear();
-                this->_debug_depth = 0; /* short-circuit */
-                this->leave_debug();
-            }
+                this->abandon_debug();
             else if ( fh.null() )
             {
                 this->trace( "FATAL: no fault handler installed" );
@@ -283,7 +283,8 @@ enum _VM_Trace
     _VM_T_Constraints, /* ( weak void * ) */
     _VM_T_LeakCheck,   /* () */
     _VM_T_TypeAlias,   /* ( void *, const char * ): create a type alias */
-    _VM_T_DebugPersist /* ( void **, weak void * ) */
+    _VM_T_DebugPersist, /* ( void **, weak void * ) */
+    _VM_T_Symmetric    /* ( void *array ): the order of the pointers in array is irrelevant */
 };
 
 /* XXX. Flags stored in _VM_CR_Flags, set/cleared by __vm_ctl_flag(). */
@@ -624,6 +624,9 @@ namespace divine::vm
                     case _VM_T_DebugPersist:
                         context().trace( TraceDebugPersist{ operandCk< PointerV >( 1 ).cooked() } );
                         return;
+                    case _VM_T_Symmetric:
+                        context().trace( TraceSymmetric{ ptr2h( operandCk< PointerV >( 1 ) ) } );
+                        return;
                     default:
                         fault( _VM_F_Hypercall ) << "invalid __vm_trace type " << t;
                 }
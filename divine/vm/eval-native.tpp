@@ -0,0 +1,134 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+#include <divine/vm/eval.hpp>
+#include <divine/vm/lx-code.hpp>
+#include <limits>
+
+namespace divine::vm
+{
+
+    /* Called in place of the 'call' instruction, i.e. the operands are the
+     * arguments of the function and the result is its return value. The
+     * native code works on the heap directly, so data, definedness, taints
+     * and pointers are all carried over exactly as the loads and stores of
+     * the interpreted function would carry them. No frame is created, hence
+     * the debugger (which runs in debug mode) always gets the bitcode. */
+    template< typename Ctx >
+    bool Eval< Ctx >::implement_native( lx::Native id )
+    {
+        if ( context().debug_mode() )
+            return false;
+
+        switch ( id )
+        {
+            case lx::NativeMemcpy:
+            case lx::NativeMemmove: return native_memcpy();
+            case lx::NativeMemset:  return native_memset();
+            case lx::NativeStrlen:  return native_strlen();
+            default: return false;
+        }
+    }
+
+    /* Serves both memcpy and memmove, since copies within a single object
+     * (including the overlapping ones, which are a fault in memcpy) are left
+     * to the interpreter. */
+    template< typename Ctx >
+    bool Eval< Ctx >::native_memcpy()
+    {
+        if ( operand( 2 ).type != Slot::I64 || result().size() % PointerBytes )
+            return false;
+
+        auto dst = operand< PointerV >( 0 ), src = operand< PointerV >( 1 );
+        auto n = operand< value::Int< 64 > >( 2 );
+
+        if ( !n.defined() || n.cooked() > uint64_t( std::numeric_limits< int >::max() ) )
+            return false;
+
+        int size = n.cooked();
+        if ( !boundcheck_nop( dst, size, true ) || !boundcheck_nop( src, size, false ) )
+            return false;
+        if ( ptr2h( dst ).object() == ptr2h( src ).object() )
+            return false;
+
+        if ( !heap().copy( ptr2h( src ), ptr2h( dst ), size ) )
+            return false;
+
+        context().flush_ptr2i();
+        if ( result().size() )
+            slot_copy( s2ptr( operand( 0 ) ), result(), result().size() );
+        return true;
+    }
+
+    template< typename Ctx >
+    bool Eval< Ctx >::native_memset()
+    {
+        if ( operand( 1 ).type != Slot::I32 || operand( 2 ).type != Slot::I64 ||
+             result().size() % PointerBytes )
+            return false;
+
+        auto dst = operand< PointerV >( 0 );
+        auto n = operand< value::Int< 64 > >( 2 );
+
+        if ( !n.defined() || n.cooked() > uint64_t( std::numeric_limits< int >::max() ) )
+            return false;
+
+        int size = n.cooked();
+        if ( !boundcheck_nop( dst, size, true ) )
+            return false;
+
+        value::Int< 8 > byte( operand< value::Int< 32 > >( 1 ) ); /* (unsigned char) c */
+        PointerV p( ptr2h( dst ) );
+        for ( int i = 0; i < size; ++i )
+            heap().write_shift( p, byte );
+
+        context().flush_ptr2i();
+        if ( result().size() )
+            slot_copy( s2ptr( operand( 0 ) ), result(), result().size() );
+        return true;
+    }
+
+    /* The interpreted strlen faults on an undefined character (it branches on
+     * it), which is left to the interpreter to report. */
+    template< typename Ctx >
+    bool Eval< Ctx >::native_strlen()
+    {
+        if ( result().type != Slot::I64 )
+            return false;
+
+        PointerV p = operand< PointerV >( 0 );
+        value::Int< 8 > ch;
+        int64_t len = 0;
+
+        for ( ;; ++len, p = p + 1 )
+        {
+            if ( !boundcheck_nop( p, 1, false ) )
+                return false;
+            heap().read( ptr2h( p ), ch );
+            if ( !ch.defined() || ch.taints() )
+                return false;
+            if ( !ch.cooked() )
+                break;
+        }
+
+        result( value::Int< 64 >( len ) );
+        return true;
+    }
+
+}
+
+// vim: syntax=cpp tabstop=4 shiftwidth=4 expandtab ft=cpp
@@ -109,6 +109,11 @@ namespace divine::vm
             return;
         }
 
+#if OPT_NATIVE
+        if ( function.native && !invoke && implement_native( function.native ) )
+            return;
+#endif
+
         auto frameptr = makeobj( program().function( target ).framesize );
         auto p = frameptr;
         heap().write_shift( p, PointerV( target ) );
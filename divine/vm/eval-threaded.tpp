@@ -0,0 +1,108 @@
+// -*- mode: C++; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+
+/*
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+#include <divine/vm/eval.hpp>
+#include <divine/vm/lx-code.hpp>
+
+namespace divine::vm
+{
+
+/* The handlers must compute exactly what dispatch() computes for the same
+ * instruction (the t-eval tests run each program with both engines). */
+template< typename Ctx > template< int op, typename T >
+void Eval< Ctx >::threaded()
+{
+    V< Ctx, T > v( this );
+    auto a = v.get( 1 ), b = v.get( 2 );
+
+    if constexpr ( op == lx::ThreadedAdd ) result( a + b );
+    if constexpr ( op == lx::ThreadedSub ) result( a - b );
+    if constexpr ( op == lx::ThreadedMul ) result( a * b );
+    if constexpr ( op == lx::ThreadedAnd ) result( a & b );
+    if constexpr ( op == lx::ThreadedOr  ) result( a | b );
+    if constexpr ( op == lx::ThreadedXor ) result( a ^ b );
+    if constexpr ( op == lx::ThreadedShl ) result( a << b );
+    if constexpr ( op == lx::ThreadedLShr ) result( a >> b );
+    if constexpr ( op == lx::ThreadedAShr ) result( a.make_signed() >> b );
+
+    if constexpr ( op == lx::ThreadedEQ  ) result( a == b );
+    if constexpr ( op == lx::ThreadedNE  ) result( a != b );
+    if constexpr ( op == lx::ThreadedULT ) result( a <  b );
+    if constexpr ( op == lx::ThreadedULE ) result( a <= b );
+    if constexpr ( op == lx::ThreadedUGT ) result( a >  b );
+    if constexpr ( op == lx::ThreadedUGE ) result( a >= b );
+    if constexpr ( op == lx::ThreadedSLT ) result( a.make_signed() <  b.make_signed() );
+    if constexpr ( op == lx::ThreadedSLE ) result( a.make_signed() <= b.make_signed() );
+    if constexpr ( op == lx::ThreadedSGT ) result( a.make_signed() >  b.make_signed() );
+    if constexpr ( op == lx::ThreadedSGE ) result( a.make_signed() >= b.make_signed() );
+}
+
+/* Direct threading with computed goto (a GNU extension, which both gcc and
+ * clang support): each handler ends with its own copy of the fetch and the
+ * indirect jump to the next handler, which makes the jumps much easier to
+ * predict than the single indirect jump of a switch. Only instructions
+ * without a handler go through dispatch(), which is also where the checks
+ * for __vm_choose (in 'seq' mode) live, since it never gets a handler. */
+template< typename Ctx > template< bool seq >
+bool Eval< Ctx >::run_threaded( bool continued )
+{
+#define LX_LABEL( op, w ) && op ## _ ## w,
+#define LX_LABELS( op ) LX_THREADED_WIDTHS( LX_LABEL, op )
+    static void * const handlers[] = { &&generic, LX_THREADED_OPS( LX_LABELS ) };
+#undef LX_LABELS
+#undef LX_LABEL
+
+    static_assert( sizeof( handlers ) / sizeof( void * ) ==
+                   1 + lx::ThreadedCount * lx::threaded_widths );
+
+#define LX_NEXT                                                       \
+    do {                                                              \
+        if ( context().flags_any( _VM_CF_Stop ) )                     \
+            return false;                                             \
+        advance();                                                    \
+        goto *handlers[ instruction().handler ];                      \
+    } while ( 0 )
+
+    if ( continued )
+        refresh(), dispatch();
+    else
+        context().reset_interrupted();
+
+    advance();
+    goto *handlers[ instruction().handler ];
+
+generic:
+    if ( seq && instruction().opcode == lx::OpHypercall &&
+                instruction().subcode == lx::HypercallChoose )
+        return true;
+    dispatch();
+    LX_NEXT;
+
+#define LX_HANDLER( op, w )                                           \
+    op ## _ ## w:                                                     \
+        threaded< lx::Threaded ## op, value::Int< w > >();            \
+        LX_NEXT;
+#define LX_HANDLERS( op ) LX_THREADED_WIDTHS( LX_HANDLER, op )
+    LX_THREADED_OPS( LX_HANDLERS )
+#undef LX_HANDLERS
+#undef LX_HANDLER
+#undef LX_NEXT
+}
+
+}
+
+// vim: syntax=cpp tabstop=4 shiftwidth=4 expandtab ft=cpp
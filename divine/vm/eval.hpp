@@ -429,6 +429,16 @@ public:
 
     void implement_call( bool invoke );
 
+    /* Native implementations of (some) libc functions, see lx::Native. Each
+     * returns false without touching the state of the program if it cannot
+     * guarantee the same outcome as interpreting the function would have,
+     * and the call then proceeds as usual. That includes all cases in which
+     * the function would fault. */
+    bool implement_native( lx::Native id );
+    bool native_memcpy();
+    bool native_memset();
+    bool native_strlen();
+
     void implement_dbg_call()
     {
         if ( context().enter_debug() )
@@ -439,6 +449,16 @@ public:
     bool run_seq( bool continued );
     void dispatch(); /* evaluate a single instruction */
 
+    /* The two execution engines behind run() and run_seq(): the former
+     * calls dispatch() for each instruction, the latter jumps directly to the
+     * pre-decoded handler of the instruction (see lx::Threaded), falling back
+     * to dispatch() for instructions without one. Which one is used is
+     * decided at build time (OPT_THREADED). In 'seq' mode, the engine stops
+     * before a __vm_choose hypercall and returns true. */
+    template< bool seq > bool run_switch( bool continued );
+    template< bool seq > bool run_threaded( bool continued );
+    template< int op, typename T > void threaded(); /* a single handler */
+
     bool assert_flag( uint64_t flag, std::string_view str )
     {
         if ( context().flags_all( flag ) )
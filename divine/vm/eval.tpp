@@ -28,6 +28,8 @@
 #include <divine/vm/eval-hyper.tpp>
 #include <divine/vm/eval-intrin.tpp>
 #include <divine/vm/eval-bounds.tpp>
+#include <divine/vm/eval-threaded.tpp>
+#include <divine/vm/eval-native.tpp>
 
 namespace divine::vm
 {
@@ -748,18 +750,8 @@ void Eval< Ctx >::dispatch() /* evaluate a single instruction */
     }
 }
 
-template< typename Ctx >
-void Eval< Ctx >::run()
-{
-    context().reset_interrupted();
-    do {
-        advance();
-        dispatch();
-    } while ( !context().flags_any( _VM_CF_Stop ) );
-}
-
-template< typename Ctx >
-bool Eval< Ctx >::run_seq( bool continued )
+template< typename Ctx > template< bool seq >
+bool Eval< Ctx >::run_switch( bool continued )
 {
     if ( continued )
         refresh(), dispatch();
@@ -768,7 +760,8 @@ bool Eval< Ctx >::run_seq( bool continued )
 
     do {
         advance();
-        if ( instruction().opcode == lx::OpHypercall && instruction().subcode == lx::HypercallChoose )
+        if ( seq && instruction().opcode == lx::OpHypercall &&
+                    instruction().subcode == lx::HypercallChoose )
             return true;
         dispatch();
     } while ( !context().flags_any( _VM_CF_Stop ) );
@@ -776,6 +769,26 @@ bool Eval< Ctx >::run_seq( bool continued )
     return false;
 }
 
+template< typename Ctx >
+void Eval< Ctx >::run()
+{
+#if OPT_THREADED
+    run_threaded< false >( false );
+#else
+    run_switch< false >( false );
+#endif
+}
+
+template< typename Ctx >
+bool Eval< Ctx >::run_seq( bool continued )
+{
+#if OPT_THREADED
+    return run_threaded< true >( continued );
+#else
+    return run_switch< true >( continued );
+#endif
+}
+
 }
 
 // vim: syntax=cpp tabstop=4 shiftwidth=4 expandtab ft=cpp
@@ -18,6 +18,7 @@
 
 #pragma once
 #include <divine/vm/lx-slot.hpp>
+#include <string_view>
 
 DIVINE_RELAX_WARNINGS
 #include <llvm/IR/Instructions.h>
@@ -64,4 +65,104 @@ enum DbgSubcode
 {
     DbgValue, DbgDeclare, DbgBitCast
 };
+
+/* Functions which the evaluator can execute natively (see Eval::implement_native),
+ * instead of interpreting their bitcode. The libc marks the candidates with
+ * __native (the 'divine.native' annotation), and the native code is looked
+ * up by the name of the function. */
+
+enum Native { NotNative, NativeMemcpy, NativeMemmove, NativeMemset, NativeStrlen };
+
+static inline Native native( std::string_view name, int &argcount )
+{
+    if ( name == "memcpy" )  return argcount = 3, NativeMemcpy;
+    if ( name == "memmove" ) return argcount = 3, NativeMemmove;
+    if ( name == "memset" )  return argcount = 3, NativeMemset;
+    if ( name == "strlen" )  return argcount = 1, NativeStrlen;
+    return NotNative;
+}
+
+/* Pre-decoded handlers for the threaded evaluator (Eval::run_threaded). Each
+ * handler implements a single opcode (and subcode, for icmp) on integer
+ * operands of a fixed width, so that it can skip the opcode switch and the
+ * type dispatch of Eval::dispatch. Handler 0 (the default) means that the
+ * instruction is executed by Eval::dispatch. The order of the operations and
+ * of the widths must agree with the table in Eval::run_threaded. */
+
+#define LX_THREADED_OPS( X ) \
+    X( Add ) X( Sub ) X( Mul ) X( And ) X( Or ) X( Xor ) X( Shl ) X( LShr ) X( AShr ) \
+    X( EQ ) X( NE ) X( ULT ) X( ULE ) X( UGT ) X( UGE ) X( SLT ) X( SLE ) X( SGT ) X( SGE )
+
+#define LX_THREADED_WIDTHS( X, op ) X( op, 1 ) X( op, 8 ) X( op, 16 ) X( op, 32 ) X( op, 64 )
+
+enum Threaded
+{
+#define LX_THREADED_ENUM( op ) Threaded ## op,
+    LX_THREADED_OPS( LX_THREADED_ENUM )
+#undef LX_THREADED_ENUM
+    ThreadedCount
+};
+
+static constexpr int threaded_widths = 5;
+
+static inline int threaded_width( Slot::Type t )
+{
+    switch ( t )
+    {
+        case Slot::I1:  return 0;
+        case Slot::I8:  return 1;
+        case Slot::I16: return 2;
+        case Slot::I32: return 3;
+        case Slot::I64: return 4;
+        default: return -1;
+    }
+}
+
+static inline int threaded_op( int opcode, int subcode )
+{
+    using I = llvm::Instruction;
+    using C = llvm::ICmpInst;
+
+    switch ( opcode )
+    {
+        case I::Add: return ThreadedAdd;
+        case I::Sub: return ThreadedSub;
+        case I::Mul: return ThreadedMul;
+        case I::And: return ThreadedAnd;
+        case I::Or:  return ThreadedOr;
+        case I::Xor: return ThreadedXor;
+        case I::Shl: return ThreadedShl;
+        case I::LShr: return ThreadedLShr;
+        case I::AShr: return ThreadedAShr;
+        case I::ICmp:
+            switch ( subcode )
+            {
+                case C::ICMP_EQ:  return ThreadedEQ;
+                case C::ICMP_NE:  return ThreadedNE;
+                case C::ICMP_ULT: return ThreadedULT;
+                case C::ICMP_ULE: return ThreadedULE;
+                case C::ICMP_UGT: return ThreadedUGT;
+                case C::ICMP_UGE: return ThreadedUGE;
+                case C::ICMP_SLT: return ThreadedSLT;
+                case C::ICMP_SLE: return ThreadedSLE;
+                case C::ICMP_SGT: return ThreadedSGT;
+                case C::ICMP_SGE: return ThreadedSGE;
+                default: return -1;
+            }
+        default: return -1;
+    }
+}
+
+/* Pick the handler for an instruction with the given result and operand
+ * types (binary operations only). */
+static inline int threaded( int opcode, int subcode, Slot::Type res, Slot::Type a, Slot::Type b )
+{
+    int op = threaded_op( opcode, subcode ), width = threaded_width( a );
+    if ( op < 0 || width < 0 || a != b )
+        return 0;
+    if ( op < ThreadedEQ ? res != a : res != Slot::I1 )
+        return 0;
+    return 1 + op * threaded_widths + width;
+}
+
 }
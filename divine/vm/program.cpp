@@ -31,10 +31,17 @@ DIVINE_RELAX_WARNINGS
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Module.h>
 #include <llvm/ADT/StringMap.h>
+#include <llvm/IR/InstIterator.h>
 DIVINE_UNRELAX_WARNINGS
 
 #include <brick-llvm>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 using namespace divine::vm;
 using llvm::isa;
 using llvm::dyn_cast;
@@ -114,25 +121,88 @@ Program::Slot Program::initSlot( llvm::Value *val, Slot::Location loc )
     return result;
 }
 
-bool Program::lifetimeOverlap( llvm::Value *v_a, llvm::Value *v_b ) {
-    auto a = dyn_cast< llvm::Instruction >( v_a );
-    auto b = dyn_cast< llvm::Instruction >( v_b );
-    if ( !a || !b )
-        return true;
+/* Run f( i ) for each i in [ 0, n ) on a few threads. Each index is handled
+ * by exactly one of the threads and f may only touch data which belongs to
+ * that index, hence the result does not depend on the schedule. An exception
+ * cannot leave a thread, so the first one thrown by f (e.g. a failed ASSERT)
+ * stops the remaining work and is rethrown once all the threads are joined. */
+template< typename F >
+static void parallel( int n, F f )
+{
+    int threads = std::min( n, int( std::thread::hardware_concurrency() ) );
+    std::atomic< int > next( 0 );
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto work = [&]
+    {
+        try
+        {
+            for ( int i = next++; i < n; i = next++ )
+                f( i );
+        }
+        catch ( ... )
+        {
+            std::lock_guard< std::mutex > _( error_lock );
+            if ( !error )
+                error = std::current_exception();
+            next = n;
+        }
+    };
 
-    auto id = a->getMetadata( "lart.id" );
-    auto list = b->getMetadata( "lart.interference" );
+    std::vector< std::thread > pool;
+    for ( int i = 1; i < threads; ++i )
+        pool.emplace_back( work );
+    work();
+    for ( auto &t : pool )
+        t.join();
 
-    if ( !list || !id )
-        return true;
-    for ( int i = 0; i < int( list->getNumOperands() ); ++i ) {
-        auto item = dyn_cast< llvm::MDNode >( list->getOperand( i ) );
-        if ( item == id )
-            return true;
-    }
-    return false;
+    if ( error )
+        std::rethrow_exception( error );
+}
+
+/* Reading the interference metadata is the expensive part of the frame
+ * layout, and each function only reads its own instructions, so this runs
+ * in parallel. The metadata kinds are looked up beforehand, since doing
+ * that by name may modify the LLVMContext. */
+void Program::decodeLayout( llvm::Module *m )
+{
+    auto id_kind = m->getContext().getMDKindID( "lart.id" ),
+         list_kind = m->getContext().getMDKindID( "lart.interference" );
+
+    std::vector< llvm::Function * > todo;
+    for ( auto &f : *m )
+        if ( !f.isDeclaration() )
+        {
+            int idx = _addr.code( &f ).function();
+            makeFit( todo, idx );
+            todo[ idx ] = &f;
+        }
+
+    _layout.clear();
+    _layout.resize( todo.size() );
+
+    parallel( todo.size(), [&]( int idx )
+    {
+        if ( !todo[ idx ] )
+            return;
+
+        auto &meta = _layout[ idx ].meta;
+        for ( auto &insn : llvm::instructions( *todo[ idx ] ) )
+            if ( auto list = insn.getMetadata( list_kind ) )
+            {
+                auto &i = meta[ &insn ];
+                i.id = insn.getMetadata( id_kind );
+                for ( int op = 0; op < int( list->getNumOperands() ); ++op )
+                    if ( auto item = dyn_cast< llvm::MDNode >( list->getOperand( op ) ) )
+                        i.with.push_back( item );
+            }
+    } );
 }
 
+/* Find the lowest offset at which the slot does not intersect any interval
+ * blocked for 'val', i.e. taken by a value whose lifetime overlaps with its
+ * own. Values without interference metadata never share their space. */
 void Program::overlaySlot( int fun, Slot &result, llvm::Value *val )
 {
     if ( !result.width() )
@@ -141,20 +211,12 @@ void Program::overlaySlot( int fun, Slot &result, llvm::Value *val )
         return;
     }
 
-    int iter = 0;
     auto &f = functions[ fun ];
-    makeFit( coverage, fun );
-    auto &c = coverage[ fun ];
-    llvm::Instruction *insn;
-
-    if ( !val )
-        goto alloc;
+    makeFit( _layout, fun );
+    auto &l = _layout[ fun ];
+    auto insn = llvm::dyn_cast_or_null< llvm::Instruction >( val );
 
-    insn = dyn_cast< llvm::Instruction >( val );
-    if ( !insn )
-        goto alloc;
-
-    if ( insn->getOpcode() == llvm::Instruction::BitCast )
+    if ( insn && insn->getOpcode() == llvm::Instruction::BitCast )
     {
         auto src = insert( fun, insn->getOperand( 0 ) );
         ASSERT_EQ( src.width(), result.width() );
@@ -163,37 +225,43 @@ void Program::overlaySlot( int fun, Slot &result, llvm::Value *val )
         return;
     }
 
-    if ( !insn->getMetadata( "lart.interference" ) )
-        goto alloc;
-
-    ASSERT( !f.instructions.empty() );
-    c.resize( f.framesize );
-
-    for ( result.offset = 2 * PointerBytes; result.offset < f.framesize; ) {
-        iter ++;
-        if ( result.offset + result.size() > f.framesize )
-            goto alloc;
-
-        bool good = true;
-        for ( int i = 0; good && i < result.size(); ++i )
-            for ( auto v : c[ result.offset + i ] )
-                if ( lifetimeOverlap( val, v ) ) {
-                    ASSERT( valuemap.find( v ) != valuemap.end());
-                    auto s = valuemap[ v ];
-                    result.offset = s.offset + s.size();
-                    good = false;
-                    break;
-                }
+    auto meta = insn ? l.meta.find( insn ) : l.meta.end();
+    int size = result.size();
+    bool found = false;
 
-        if ( good )
-            goto out;
+    if ( meta != l.meta.end() && meta->second.id )
+    {
+        ASSERT( !f.instructions.empty() );
+        std::vector< Interval > busy = l.fixed;
+        if ( auto b = l.blocked.find( meta->second.id ); b != l.blocked.end() )
+            busy.insert( busy.end(), b->second.begin(), b->second.end() );
+        std::sort( busy.begin(), busy.end(),
+                   []( auto a, auto b ) { return a.from < b.from; } );
+
+        int offset = 2 * PointerBytes;
+        for ( auto i : busy )
+        {
+            if ( i.from >= offset + size )
+                break;
+            offset = std::max( offset, i.to );
+        }
+
+        if ( ( found = offset + size <= f.framesize ) )
+            result.offset = offset;
+    }
+
+    if ( !found )
+    {
+        result.offset = f.framesize;
+        f.framesize += brick::bitlevel::align( size, framealign );
     }
-alloc:
-    result.offset = f.framesize;
-    f.framesize += brick::bitlevel::align( result.size(), framealign );
-    c.resize( f.framesize );
-out:
-    c[ result.offset ].push_back( val );
+
+    Interval taken{ result.offset, result.offset + size };
+    if ( meta != l.meta.end() )
+        for ( auto id : meta->second.with )
+            l.blocked[ id ].push_back( taken );
+    else
+        l.fixed.push_back( taken );
 }
 
 static bool is_constant( llvm::GlobalVariable *gv )
@@ -293,18 +361,12 @@ template< typename Insn >
 void Program::insertIndices( Position p )
 {
     Insn *I = cast< Insn >( p.I );
-    Program::Instruction &insn = instruction( p.pc );
-
-    int shift = insn.values.size();
-    insn.values.resize( shift + I->getNumIndices() );
+    auto &vs = operands( p.pc );
 
     for ( unsigned i = 0; i < I->getNumIndices(); ++i )
     {
-        Slot v( Slot::Const, Slot::I32 );
-        auto slot = allocateSlot( v );
-        _toinit.emplace_back(
-            [=]{ initConstant( slot, value::Int< 32 >( I->getIndices()[ i ] ) ); } );
-        insn.values[ shift + i ] = slot;
+        auto idx = I->getIndices()[ i ];
+        vs.push_back( internConstant( Slot::I32, idx, value::Int< 32 >( idx ) ) );
     }
 }
 
@@ -354,12 +416,14 @@ Program::Position Program::insert( Position p )
 
     if ( !codepointers )
     {
-        int operands = p.I->getNumOperands() - ( insn.opcode == lx::OpHypercall );
-        insn.values.resize( 1 + operands );
-        for ( int i = 0; i < operands; ++i )
+        auto &vs = operands( p.pc );
+        int count = p.I->getNumOperands() - ( insn.opcode == lx::OpHypercall );
+        vs.clear();
+        vs.resize( 1 + count );
+        for ( int i = 0; i < count; ++i )
             if ( !isa< llvm::MetadataAsValue >( p.I->getOperand( i ) ) )
-                insn.values[ i + 1 ] = insert( p.pc.function(), p.I->getOperand( i ) );
-        insn.values[0] = insert( p.pc.function(), &*p.I );
+                vs[ i + 1 ] = insert( p.pc.function(), p.I->getOperand( i ) );
+        vs[0] = insert( p.pc.function(), &*p.I );
 
         if ( auto PHI = dyn_cast< llvm::PHINode >( p.I ) )
         {
@@ -368,9 +432,7 @@ Program::Position Program::insert( Position p )
             {
                 if ( nPHI ) ASSERT_EQ( PHI->getIncomingBlock( idx ), nPHI->getIncomingBlock( idx ) );
                 auto from = _addr.terminator( PHI->getIncomingBlock( idx ) );
-                auto slot = allocateSlot( Slot( Slot::Const, Slot::PtrC ) );
-                _toinit.emplace_back( [=]{ initConstant( slot, value::Pointer( from ) ); } );
-                insn.values.push_back( slot );
+                vs.push_back( internConstant( Slot::PtrC, from.raw(), value::Pointer( from ) ) );
             }
         }
 
@@ -417,12 +479,17 @@ void Program::computeRR( llvm::Module *module )
                                             {
                                                 is_trap.insert( _addr.code( f ).function() );
                                             } );
+    brick::llvm::enumerateFunctionsForAnno( "divine.native", *module, [this]( llvm::Function *f )
+                                            {
+                                                is_native.insert( f );
+                                            } );
 
     framealign = 1;
 
     codepointers = true;
     pass( module );
     codepointers = false;
+    decodeLayout( module );
 
     for ( auto var = module->global_begin(); var != module->global_end(); ++ var )
     {
@@ -443,8 +510,73 @@ void Program::computeRR( llvm::Module *module )
     framealign = 1;
     pass( module );
 
+    pack();
+    setupNative();
+
     _types.reset( new LXTypes( _ccontext._heap, _types_gen.emit( _ccontext._heap ) ) );
-    coverage.clear();
+    _layout.clear();
+}
+
+/* A function is only executed natively if its bitcode has no hypercalls and
+ * calls nothing but debug intrinsics: the native code does not evaluate
+ * interrupt points (LART inserts those when the function is instrumented for
+ * memory interrupts) nor tests for taints, and it accesses the heap directly,
+ * while other LART passes (e.g. weakmem under --relaxed) replace the loads and
+ * stores of the function with calls. */
+void Program::setupNative()
+{
+    for ( auto f : is_native )
+    {
+        if ( f->isDeclaration() )
+            continue;
+
+        int argcount = 0;
+        auto id = lx::native( f->getName().str(), argcount );
+        auto &fun = function( f );
+
+        if ( !id || fun.vararg || fun.argcount != argcount )
+            continue;
+
+        bool calls = false;
+        for ( auto &insn : fun.instructions )
+            if ( insn.opcode == lx::OpHypercall || insn.opcode == llvm::Instruction::Call ||
+                 insn.opcode == llvm::Instruction::Invoke )
+                calls = true;
+
+        if ( !calls )
+            fun.native = id;
+    }
+}
+
+/* The functions are packed independently of each other (in parallel). */
+void Program::pack()
+{
+    parallel( functions.size(), [&]( int idx )
+    {
+        auto &f = functions[ idx ];
+        size_t total = 0;
+        for ( auto &vs : f._operands )
+            total += vs.size();
+
+        f.values.clear();
+        f.values.reserve( total ); /* the instructions point into the array */
+
+        for ( int i = 0; i < int( f.instructions.size() ); ++i )
+        {
+            if ( i >= int( f._operands.size() ) )
+                break;
+            auto &vs = f._operands[ i ];
+            auto &insn = f.instructions[ i ];
+            insn.bind( f.values.data() + f.values.size(), vs.size() );
+            f.values.insert( f.values.end(), vs.begin(), vs.end() );
+            if ( vs.size() == 3 )
+                insn.handler = lx::threaded( insn.opcode, insn.subcode,
+                                             vs[ 0 ].type, vs[ 1 ].type, vs[ 2 ].type );
+        }
+
+        ASSERT_EQ( f.values.size(), total );
+        std::vector< std::vector< Slot > >().swap( f._operands );
+    } );
 }
 
 void Program::computeStatic( llvm::Module *module )
@@ -532,8 +664,8 @@ void Program::computeStatic( llvm::Module *module )
             auto &inst = func.instructions[ j ];
             writeInst( inst.opcode );
             writeInst( inst.subcode );
-            writeInst( inst.values.empty() ? 0 : inst.result().offset );
-            writeInst( inst.values.empty() ? 0 : inst.result().size() ); /* bytes? */
+            writeInst( inst.has_result() ? inst.result().offset : 0 );
+            writeInst( inst.has_result() ? inst.result().size() : 0 ); /* bytes? */
         }
         ASSERT_EQ( instTable.cooked().offset() - instOffset, instTableSize );
 
@@ -570,7 +702,7 @@ void Program::pass( llvm::Module *module )
             for ( auto &arg : function.args() )
             {
                 this->instruction( apc ).opcode = lx::OpArg;
-                auto &vs = this->instruction( apc ).values;
+                auto &vs = operands( apc );
                 makeFit( vs, 1 );
                 vs[ 0 ] = insert( pc.function(), &arg );
                 apc = apc + 1;
@@ -584,7 +716,7 @@ void Program::pass( llvm::Module *module )
                     Slot vaptr( Slot::Local );
                     vaptr.type = Slot::Ptr;
                     overlaySlot( pc.function(), vaptr, nullptr );
-                    auto &vs = this->instruction( apc ).values;
+                    auto &vs = operands( apc );
                     makeFit( vs, 1 );
                     vs[ 0 ] = vaptr;
                     this->instruction( apc ).opcode = lx::OpArg;
@@ -60,13 +60,16 @@ namespace divine::vm
  * belonging to that function).
  *
  * Instruction operands are always slot references, there is no support for
- * immediates (yet?). Constant data is all stashed away in a single heap object
- * which is split into a number of slots of variable size, each containing a
- * single value. Constants are not de-duplicated. This arrangement is
- * unfortunately not very cache-friendly. Within an instruction, operands are
- * held in a SmallVector, so most instructions should be stored continuously,
- * but they are still rather inefficient. A better representation is in the
- * works. */
+ * immediates: operands are addressed as memory by the evaluator, the debugger
+ * and the hypercalls alike. Constant data is all stashed away in a single heap
+ * object which is split into a number of slots of variable size, each
+ * containing a single value. Constants which come from LLVM are unique (LLVM
+ * takes care of that), and the constants synthesised during translation
+ * (incoming blocks of PHI nodes, aggregate indices) are interned. The operands
+ * of all instructions of a function are packed into a single array, in the
+ * order of the instructions, once the translation is finished (see pack()).
+ * Each instruction is then a fixed-size record which points into that array,
+ * so that executing a basic block touches two contiguous chunks of memory. */
 
 struct Program
 {
@@ -79,48 +82,59 @@ struct Program
      * atomicrmw multi-purpose opcodes) or an index into the type table (for
      * GEP or alloca) or the offset of the landing pad for invoke instructions.
      * For 'call' instructions, the subcode (if nonzero) indicates the ID of
-     * the intrinsic function. The 'values' member holds all Slots belonging
-     * to this instruction - the result and all operands. */
+     * the intrinsic function. The 'values' of the instruction are all Slots
+     * belonging to this instruction - the result and all operands. They are
+     * stored in the operand array of the function (see Function::values).
+     * The handler is used by the threaded evaluator (see lx::Threaded). */
     struct Instruction
     {
         uint32_t opcode:16;
         uint32_t subcode:16;
-        Slot result() const { ASSERT( values.size() ); return values[0]; }
+        uint32_t handler:8;
+        Slot result() const { ASSERT( _count ); return _values[0]; }
 
         Slot operand( int i ) const
         {
-            int idx = (i >= 0) ? (i + 1) : (i + values.size());
-            ASSERT_LT( idx, values.size() );
-            return values[ idx ];
+            int idx = (i >= 0) ? (i + 1) : (i + int( _count ));
+            ASSERT_LT( idx, int( _count ) );
+            return _values[ idx ];
         }
 
         /* Negative indices are used for fetching values from the back,
          * -1 denotes the last value, -2 second last, etc. */
         Slot value( int i ) const
         {
-            int idx = (i >= 0) ? i : (i + values.size());
-            ASSERT_LT( idx, values.size() );
-            return values[ idx ];
+            int idx = (i >= 0) ? i : (i + int( _count ));
+            ASSERT_LT( idx, int( _count ) );
+            return _values[ idx ];
         }
 
-        int argcount() const { return values.size() - 1; }
-        bool has_result() const { return values.size() > 0; }
+        int argcount() const { return int( _count ) - 1; }
+        bool has_result() const { return _count > 0; }
 
-        Instruction() : opcode( 0 ), subcode( 0 ) {}
+        /* Point the instruction at its values, which must outlive it. */
+        void bind( const Slot *values, int count )
+        {
+            ASSERT_LT( count, 1 << 24 );
+            _values = values;
+            _count = count;
+        }
+
+        Instruction() : opcode( 0 ), subcode( 0 ), handler( 0 ), _count( 0 ) {}
         Instruction( const Instruction & ) = delete;
         Instruction( Instruction && ) noexcept = default;
 
         template< typename stream >
         friend auto operator<<( stream &o, const Program::Instruction &i ) -> decltype( o << "" )
         {
-            for ( auto v : i.values )
-                o << v << " ";
+            for ( int v = 0; v < int( i._count ); ++v )
+                o << i._values[ v ] << " ";
             return o;
         }
 
     private:
-        brick::data::SmallVector< Slot, 4 > values;
-        friend struct Program;
+        uint32_t _count:24;
+        const Slot *_values = nullptr;
     };
 
     struct Function
@@ -129,7 +143,13 @@ struct Program
         int argcount:31;
         bool vararg:1;
         Slot personality;
+        lx::Native native = lx::NotNative;
         std::vector< Instruction > instructions;
+        std::vector< Slot > values; /* operands of all instructions, in order */
+
+        /* Operands of the individual instructions, used while the function
+         * is being translated; pack() moves them into 'values'. */
+        std::vector< std::vector< Slot > > _operands;
 
         Instruction &instruction( CodePointer pc )
         {
@@ -160,6 +180,7 @@ struct Program
     std::map< const llvm::Type *, int > typemap;
     std::map< const llvm::Value *, std::string > anonmap;
     std::set< const llvm::Function * > is_debug;
+    std::set< llvm::Function * > is_native;
     std::unordered_set< int > is_trap;
     std::set< HeapPointer > metadata_ptr;
 
@@ -202,6 +223,14 @@ struct Program
         return function( pc ).instruction( pc );
     }
 
+    /* The (unpacked) operands of an instruction, during translation. */
+    std::vector< Slot > &operands( CodePointer pc )
+    {
+        auto &ops = function( pc )._operands;
+        makeFit( ops, pc.instruction() );
+        return ops[ pc.instruction() ];
+    }
+
     Function &function( CodePointer pc )
     {
         ASSERT_LT( pc.function(), functions.size() );
@@ -253,14 +282,43 @@ struct Program
     Slot allocateSlot( Slot slot, int function = 0, llvm::Value *val = nullptr );
     HeapPointer s2hptr( Slot s, int offset = 0 );
 
-    using Coverage = std::vector< std::vector< llvm::Value * > >;
-    std::vector< Coverage > coverage;
+    /* The layout of the local slots of a single frame (see overlaySlot).
+     * LART attaches a 'lart.id' to each instruction and a list of the
+     * instructions which are live at the same time ('lart.interference').
+     * An allocated slot blocks its interval of the frame for the values
+     * named in its interference list, or for all values if it has none. */
+    struct Interval { int from, to; };
+    struct Interference { llvm::MDNode *id = nullptr; std::vector< llvm::MDNode * > with; };
 
-    bool lifetimeOverlap( llvm::Value *a, llvm::Value *b );
+    struct Layout
+    {
+        std::unordered_map< llvm::Instruction *, Interference > meta; /* decoded by decodeLayout */
+        std::unordered_map< llvm::MDNode *, std::vector< Interval > > blocked;
+        std::vector< Interval > fixed;
+    };
+
+    std::vector< Layout > _layout;
+
+    void decodeLayout( llvm::Module *m );
     void overlaySlot( int fun, Slot &result, llvm::Value *val );
 
     std::deque< std::function< void() > > _toinit;
     std::set< llvm::Value * > _doneinit;
+    std::map< std::pair< int, uint64_t >, Slot > _interned;
+
+    /* Constants which do not correspond to an llvm::Value are interned, i.e.
+     * all uses of the same value share a single slot. */
+    template< typename T >
+    Slot internConstant( Slot::Type type, uint64_t key, T t )
+    {
+        auto [ it, fresh ] = _interned.emplace( std::make_pair( int( type ), key ), Slot() );
+        if ( fresh )
+        {
+            auto slot = it->second = allocateSlot( Slot( Slot::Const, type ) );
+            _toinit.emplace_back( [=]{ initConstant( slot, t ); } );
+        }
+        return it->second;
+    }
 
     CodePointer bootpoint() { return _bootpoint; }
     GlobalPointer envptr() { return _envptr; }
@@ -304,6 +362,8 @@ struct Program
     int insert( llvm::Type *t );
 
     void pass( llvm::Module * ); /* internal */
+    void pack(); /* internal */
+    void setupNative(); /* internal */
 
     void setupRR( llvm::Module * );
     void computeRR( llvm::Module * ); /* RR = runtime representation */
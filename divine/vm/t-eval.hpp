@@ -59,16 +59,28 @@ struct Eval
     template< typename... Args >
     auto testP( std::shared_ptr< vm::Program > p, Args... args )
     {
-        TContext< vm::Program > c( *p );
-        auto data = p->exportHeap( c.heap() );
-        c.set( _VM_CR_Constants, data.first );
-        c.set( _VM_CR_Globals , data.second );
-        vm::Eval< TContext< vm::Program > > e( c );
-        auto pc = p->functionByName( "f" );
-        make_frame( c, pc, vm::nullPointerV(), args... );
-        c.set( _VM_CR_Flags, _VM_CF_KernelMode | _VM_CF_AutoSuspend );
-        e.run();
-        return e.retval< IntV >();
+        auto run = [&]( bool threaded )
+        {
+            TContext< vm::Program > c( *p );
+            auto data = p->exportHeap( c.heap() );
+            c.set( _VM_CR_Constants, data.first );
+            c.set( _VM_CR_Globals , data.second );
+            vm::Eval< TContext< vm::Program > > e( c );
+            auto pc = p->functionByName( "f" );
+            make_frame( c, pc, vm::nullPointerV(), args... );
+            c.set( _VM_CR_Flags, _VM_CF_KernelMode | _VM_CF_AutoSuspend );
+            if ( threaded )
+                e.template run_threaded< false >( false );
+            else
+                e.template run_switch< false >( false );
+            return e.retval< IntV >();
+        };
+
+        /* check the threaded evaluator against the switch-based one */
+        auto rv = run( false ), rv_threaded = run( true );
+        ASSERT_EQ( rv.cooked(), rv_threaded.cooked() );
+        ASSERT_EQ( rv.defbits(), rv_threaded.defbits() );
+        return rv;
     }
 
     template< typename... Args >
@@ -245,6 +245,34 @@ namespace divine::t_vm
             auto c_p = mem::clone( heap, cloned, p );
             ASSERT_EQ( mem::hash( heap, p ), mem::hash( cloned, c_p ) );
         }
+
+        TEST(reuse_visited)
+        {
+            mem::Visited v1, v2;
+            mem::NoopCmp< vm::HeapPointer > cb;
+            auto p = heap.make( 16 ).cooked(), q = p;
+
+            for ( int i = 0; i < 100; ++i ) /* enough objects to make the maps grow */
+            {
+                auto r = heap.make( 16 ).cooked();
+                heap.write( q, PointerV( r ) );
+                heap.write( q + vm::PointerBytes, IntV( i ) );
+                q = r;
+            }
+
+            auto h = mem::hash( heap, p );
+
+            for ( int i = 0; i < 3; ++i )
+            {
+                ASSERT_EQ( mem::hash( heap, p, v1 ), h );
+                ASSERT_EQ( mem::compare( heap, heap, p, p, v1, v2, cb ), 0 );
+                ASSERT_NEQ( mem::compare( heap, heap, p, q, v1, v2, cb ), 0 );
+            }
+
+            heap.write( q, PointerV( p ) ); /* close the cycle */
+            ASSERT_NEQ( mem::hash( heap, p, v1 ), h );
+            ASSERT_EQ( mem::compare( heap, heap, p, p, v1, v2, cb ), 0 );
+        }
     };
 
     struct Mutable : vm::SmallHeap {};
@@ -333,6 +361,19 @@ namespace divine::t_vm
             ASSERT_NEQ( mem::hash( heap, p ), mem::hash( heap, q ) );
         }
 
+        TEST(hash_cached)
+        {
+            auto p = heap.make( 16 ).cooked(), q = heap.make( 16 ).cooked();
+            heap.write( p, PointerV( q ) );
+            heap.write( p + vm::PointerBytes, IntV( 5 ) );
+            heap.write( q, PointerV( p ) );
+            auto fresh = mem::hash( heap, p );
+            heap.snapshot( pool ); /* the summaries of p and q are now cached */
+            ASSERT_EQ( mem::hash( heap, p ), fresh );
+            heap.write( q + vm::PointerBytes, IntV( 7 ) );
+            ASSERT_NEQ( mem::hash( heap, p ), fresh );
+        }
+
         TEST(copy_content)
         {
             auto p = heap.make( 16 ).cooked(), q = heap.make( 16 ).cooked();
@@ -447,6 +488,41 @@ namespace divine::t_vm
             heap.read( p, iv );
             ASSERT_EQ( iv.defbits(), 0 );
         }
+
+        TEST(tree)
+        {
+            heap.tree_compression( pool );
+            std::vector< vm::HeapPointer > ptrs;
+            for ( int i = 0; i < 200; ++i )
+            {
+                ptrs.push_back( heap.make( 16 ).cooked() );
+                heap.write( ptrs.back(), IntV( i ) );
+            }
+
+            auto s1 = heap.snapshot( pool );
+            heap.write( ptrs[ 100 ], IntV( 7 ) );
+            auto s2 = heap.snapshot( pool );
+            heap.write( ptrs[ 100 ], IntV( 100 ) );
+            auto s3 = heap.snapshot( pool );
+
+            ASSERT( s1 != s3 );
+            ASSERT( heap.snap_equal( pool, s1, s3 ) ); /* the nodes are shared */
+            ASSERT( !heap.snap_equal( pool, s1, s2 ) );
+
+            IntV iv;
+            auto copy = heap;
+            copy.restore( pool, s2 );
+            heap.snap_put( pool, s3 );
+            heap.restore( pool, s1 );
+
+            copy.read( ptrs[ 100 ], iv );
+            ASSERT_EQ( iv.cooked(), 7 );
+            for ( int i = 0; i < 200; ++i )
+            {
+                heap.read( ptrs[ i ], iv );
+                ASSERT_EQ( iv.cooked(), i );
+            }
+        }
     };
 
 }
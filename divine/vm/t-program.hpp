@@ -78,6 +78,69 @@ struct Program
     {
         auto m = c2prog( "int main() { return 0; }" );
     }
+
+    TEST( packed )
+    {
+        auto p = c2prog( "int f( int x ) { return x ? x + 1 : 2; }\n"
+                         "int main() { return f( 1 ) + f( 0 ); }" );
+        for ( auto &f : p->functions )
+        {
+            int total = 0;
+            for ( auto &i : f.instructions )
+            {
+                if ( !i.has_result() )
+                    continue;
+                ASSERT_EQ( i.result().location, f.values[ total ].location );
+                ASSERT_EQ( i.result().offset, f.values[ total ].offset );
+                total += i.argcount() + 1;
+            }
+            ASSERT_EQ( total, f.values.size() );
+        }
+    }
+
+    /* Two results which only differ in their interference metadata: the
+     * result of 'b' may reuse the slot of 'a' unless 'a' lists 'b'. */
+    std::pair< int, int > layout( bool interfere )
+    {
+        auto &ctx = *testContext();
+        auto i32 = llvm::Type::getInt32Ty( ctx );
+        auto ft = llvm::FunctionType::get( i32, { i32 }, false );
+        llvm::Value *a, *b;
+
+        auto p = ir2prog( [&]( auto &irb, auto *f )
+        {
+            auto x = &*f->arg_begin();
+            auto ia = llvm::cast< llvm::Instruction >( irb.CreateAdd( x, x ) );
+            auto ib = llvm::cast< llvm::Instruction >( irb.CreateMul( x, x ) );
+            irb.CreateRet( ib );
+
+            auto id_a = llvm::MDNode::get( ctx, llvm::MDString::get( ctx, "a" ) ),
+                 id_b = llvm::MDNode::get( ctx, llvm::MDString::get( ctx, "b" ) );
+            std::vector< llvm::Metadata * > with_a, with_b;
+            if ( interfere )
+                with_a.push_back( id_b );
+
+            ia->setMetadata( "lart.id", id_a );
+            ib->setMetadata( "lart.id", id_b );
+            ia->setMetadata( "lart.interference", llvm::MDNode::get( ctx, with_a ) );
+            ib->setMetadata( "lart.interference", llvm::MDNode::get( ctx, with_b ) );
+            a = ia, b = ib;
+        }, "f", ft );
+
+        return { p->valuemap[ a ].offset, p->valuemap[ b ].offset };
+    }
+
+    TEST( layout_shared )
+    {
+        auto [ a, b ] = layout( false );
+        ASSERT_EQ( a, b );
+    }
+
+    TEST( layout_interfere )
+    {
+        auto [ a, b ] = layout( true );
+        ASSERT_NEQ( a, b );
+    }
 };
 
 }
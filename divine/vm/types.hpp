@@ -96,9 +96,11 @@ namespace divine::vm
     struct TraceLeakCheck {};
     struct TraceTypeAlias { CodePointer pc; GenericPointer alias; };
     struct TraceDebugPersist { GenericPointer ptr; };
+    struct TraceSymmetric { HeapPointer ptr; };
 
     template< typename Context > struct FaultStream;
     template< typename _Program, typename _Heap > struct Context;
+    template< typename _Program, typename _Heap > struct SearchContext;
     template< typename Context > struct Eval;
 
     template< int slab >
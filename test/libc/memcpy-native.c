@@ -0,0 +1,28 @@
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+struct item { int *ptr; char name[ 12 ]; };
+
+int main()
+{
+    int x = 7;
+    struct item a = { &x, "hello" }, b;
+    memset( &b, 0, sizeof( b ) );
+    assert( !b.ptr && !b.name[ 0 ] );
+
+    memcpy( &b, &a, sizeof( a ) );
+    assert( *b.ptr == 7 );
+    assert( strlen( b.name ) == 5 );
+
+    char *buf = malloc( 32 );
+    if ( !buf )
+        return 0;
+    memset( buf, 'x', 31 );
+    buf[ 31 ] = 0;
+    memmove( buf + 1, buf, 8 ); /* same object, interpreted */
+    memmove( b.name, buf, 11 );
+    assert( strlen( buf ) == 31 );
+    assert( b.name[ 10 ] == 'x' && b.name[ 11 ] == 0 );
+    free( buf );
+}
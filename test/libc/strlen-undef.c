@@ -0,0 +1,11 @@
+#include <string.h>
+#include <stdlib.h>
+
+int main()
+{
+    char *buf = malloc( 8 );
+    if ( !buf )
+        return 0;
+    buf[ 0 ] = 'a';
+    return strlen( buf ); /* ERROR */
+}
@@ -0,0 +1,35 @@
+/* TAGS: c min */
+/* VERIFY_OPTS: --liveness --threads 2 */
+/* CC_OPTS: -Os */ // avoid duplicated states
+
+#include <dios.h>
+#include <sys/divm.h>
+#include <stdbool.h>
+
+/* the only accepting edge leads into a non-accepting self-loop: there is no
+ * accepting cycle, even though the loop is reachable through acceptance */
+
+int next( int state ) {
+    switch ( state ) {
+        case -1:
+            return 0;
+        case 0:
+            __vm_ctl_flag( 0, _VM_CF_Accepting );
+            return 1;
+        case 1:
+            return 1;
+    }
+    return 0;
+}
+
+int main() {
+    int state = -1, oldstate;
+
+    while ( true ) {
+        oldstate = 0;
+        __dios_reschedule();
+        oldstate = state;
+        state = next( state );
+        __dios_trace_f( "state: %d -> %d", oldstate, state );
+    }
+}
@@ -0,0 +1,29 @@
+/* TAGS: min threads c */
+/* VERIFY_OPTS: */
+
+// V: bitstate V_OPT: --storage bitstate
+// V: compact  V_OPT: --storage compact
+// V: external V_OPT: --storage external
+// V: tree     V_OPT: --tree-compression
+
+#include <assert.h>
+#include <pthread.h>
+volatile int shared = 0;
+
+void *thread( void *x )
+{
+    while ( shared == 0 );
+    assert( shared == 1 ); /* ERROR */
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid;
+    pthread_create( &tid, NULL, thread, NULL );
+    __sync_add_and_fetch( &shared, 1 );
+    __sync_add_and_fetch( &shared, -1 );
+    assert( shared == 0 );
+    pthread_join( tid, NULL );
+    return 0;
+}
@@ -0,0 +1,24 @@
+/* TAGS: min threads c */
+/* VERIFY_OPTS: --por */
+#include <assert.h>
+#include <pthread.h>
+#include <sys/divm.h>
+
+int shared = 0;
+
+/* the only step of this thread is infeasible, hence it must not be picked as
+ * the (trivially local) stubborn set in place of main */
+void *thread( void *x )
+{
+    __vm_cancel();
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid;
+    pthread_create( &tid, NULL, thread, NULL );
+    shared = 1;
+    assert( shared == 0 ); /* ERROR */
+    return 0;
+}
@@ -0,0 +1,38 @@
+/* TAGS: min threads c */
+/* VERIFY_OPTS: --por */
+#include <assert.h>
+#include <pthread.h>
+
+int shared = 0;
+pthread_mutex_t mutex;
+
+int work( int n )
+{
+    int sum = 0;
+    for ( int i = 0; i < n; ++i )
+        sum += i;
+    return sum;
+}
+
+void *thread( void *x )
+{
+    int v = work( 4 );
+    pthread_mutex_lock( &mutex );
+    shared += v;
+    pthread_mutex_unlock( &mutex );
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid;
+    pthread_mutex_init( &mutex, NULL );
+    pthread_create( &tid, NULL, thread, NULL );
+    int v = work( 3 );
+    pthread_mutex_lock( &mutex );
+    shared += v;
+    pthread_mutex_unlock( &mutex );
+    pthread_join( tid, NULL );
+    assert( shared == 9 );
+    return 0;
+}
@@ -0,0 +1,33 @@
+/* TAGS: min threads c */
+/* VERIFY_OPTS: --por */
+#include <assert.h>
+#include <pthread.h>
+
+int shared = 0;
+
+/* the local loops are reduced, but the race on 'shared' must not be */
+int work( int n )
+{
+    int sum = 0;
+    for ( int i = 0; i < n; ++i )
+        sum += i;
+    return sum;
+}
+
+void *thread( void *x )
+{
+    int v = work( 4 );
+    shared += v > 0;
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid;
+    pthread_create( &tid, NULL, thread, NULL );
+    int v = work( 3 );
+    shared += v > 0;
+    pthread_join( tid, NULL );
+    assert( shared == 2 ); /* ERROR */
+    return 0;
+}
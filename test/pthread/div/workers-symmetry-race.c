@@ -0,0 +1,25 @@
+/* TAGS: min threads c */
+/* VERIFY_OPTS: --symmetry */
+#include <assert.h>
+#include <pthread.h>
+
+#define N 3
+
+int done = 0;
+
+void *worker( void *x )
+{
+    ++ done;
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid[ N ];
+    for ( int i = 0; i < N; ++i )
+        pthread_create( tid + i, NULL, worker, NULL );
+    for ( int i = 0; i < N; ++i )
+        pthread_join( tid[ i ], NULL );
+    assert( done == N ); /* ERROR */
+    return 0;
+}
@@ -0,0 +1,28 @@
+/* TAGS: min threads c */
+/* VERIFY_OPTS: --symmetry */
+#include <assert.h>
+#include <pthread.h>
+
+#define N 3
+
+int done = 0;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void *worker( void *x )
+{
+    pthread_mutex_lock( &mutex );
+    ++ done;
+    pthread_mutex_unlock( &mutex );
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid[ N ];
+    for ( int i = 0; i < N; ++i )
+        pthread_create( tid + i, NULL, worker, NULL );
+    for ( int i = 0; i < N; ++i )
+        pthread_join( tid[ i ], NULL );
+    assert( done == N );
+    return 0;
+}
@@ -0,0 +1,36 @@
+# TAGS: sym min c
+. lib/testcase
+
+cat > testcase.c <<EOT
+#include <assert.h>
+
+unsigned __VERIFIER_nondet_uint();
+
+int main()
+{
+    unsigned x = __VERIFIER_nondet_uint();
+
+    /* each loop adds a stronger bound on x to the path condition, while the
+     * values stay the same: once the loop is entered, its head is covered by
+     * the state before it (subsumption), but equal to a visited state only
+     * after one more iteration */
+    while ( x > 10 ) ;
+    while ( x > 20 ) ;
+    while ( x > 30 ) ;
+    while ( x > 40 ) ;
+
+    assert( x <= 10 );
+    return 0;
+}
+EOT
+
+divine verify --symbolic testcase.c | tee plain.out
+divine verify --symbolic --subsumption testcase.c | tee subsumption.out
+grep 'error found: no' plain.out
+grep 'error found: no' subsumption.out
+
+plain=$(sed -n 's/^state count: //p' plain.out)
+reduced=$(sed -n 's/^state count: //p' subsumption.out)
+test -n "$plain"
+test -n "$reduced"
+test "$reduced" -lt "$plain"
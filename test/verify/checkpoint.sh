@@ -0,0 +1,22 @@
+# TAGS:
+. lib/testcase
+
+cat > testcase.c <<EOF
+#include <sys/divm.h>
+#include <assert.h>
+
+int main()
+{
+    unsigned x = 0;
+    for ( int i = 0; i < 18; ++i )
+        x = 2 * x + __vm_choose( 2 );
+    assert( x < ( 1u << 18 ) );
+}
+EOF
+
+# interrupt the search after the first checkpoint has been written
+divine verify --checkpoint ckpt --checkpoint-period 1 --max-time 3 testcase.c && false
+test -s ckpt
+
+divine verify --resume ckpt testcase.c | tee resumed.out
+grep 'error found: no' resumed.out
@@ -0,0 +1,43 @@
+# TAGS: min threads c
+. lib/testcase
+
+cat > testcase.c <<EOF
+#include <assert.h>
+#include <pthread.h>
+
+#define N 3
+
+int done = 0;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void *worker( void *x )
+{
+    pthread_mutex_lock( &mutex );
+    ++ done;
+    pthread_mutex_unlock( &mutex );
+    return 0;
+}
+
+int main()
+{
+    pthread_t tid[ N ];
+    for ( int i = 0; i < N; ++i )
+        pthread_create( tid + i, NULL, worker, NULL );
+    for ( int i = 0; i < N; ++i )
+        pthread_join( tid[ i ], NULL );
+    assert( done == N );
+    return 0;
+}
+EOF
+
+# the threads are identical, hence the reduction must find fewer states
+divine verify testcase.c | tee plain.out
+divine verify --symmetry testcase.c | tee symmetry.out
+grep 'error found: no' plain.out
+grep 'error found: no' symmetry.out
+
+plain=$(sed -n 's/^state count: //p' plain.out)
+reduced=$(sed -n 's/^state count: //p' symmetry.out)
+test -n "$plain"
+test -n "$reduced"
+test "$reduced" -lt "$plain"
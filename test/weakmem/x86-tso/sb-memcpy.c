@@ -0,0 +1,36 @@
+/* TAGS: min c tso */
+/* VERIFY_OPTS: --relaxed-memory tso */
+
+/* store buffering where the stores are done by memcpy: they must go through
+ * the store buffer like any other store (i.e. memcpy must not be executed
+ * natively once the weakmem pass has instrumented it) */
+
+#include <pthread.h>
+#include <string.h>
+#include <assert.h>
+
+int x, y;
+volatile int rx, ry;
+volatile size_t size = sizeof( int ); /* keep the calls to memcpy */
+
+void *t1( void *_ ) {
+    int one = 1;
+    memcpy( &x, &one, size );
+    ry = y;
+    return NULL;
+}
+
+void *t2( void *_ ) {
+    int one = 1;
+    memcpy( &y, &one, size );
+    rx = x;
+    return NULL;
+}
+
+int main() {
+    pthread_t t1t;
+    pthread_create( &t1t, NULL, &t1, NULL );
+    t2( NULL );
+    pthread_join( t1t, NULL );
+    assert( !( rx == 0 && ry == 0 ) ); /* ERROR */
+}